@@ -0,0 +1,108 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== adaptive quality =======================================================
+// While the smoothed scroll velocity is above fast_scroll_speed, Paint() draws
+// only what is already cheap: the item's prescaled mip (nearest size, any
+// zoom) or a flat tint, with no labels, badges or hover. 120 ms after the last
+// scroll step the view is repainted in full and TASK_REFINE rescales visible
+// thumbnails to their exact tile size, one per idle slice. Shrinking is an
+// area average written straight into a pooled buffer (see TilePool.cpp).
+
+// Box-filtered downscale: each target pixel averages the source pixels that
+// map onto it. dst is no larger than src on either axis.
+static void s_shrink(const Image& src, ImageBuffer& dst)
+{
+    const Size ss = src.GetSize(), ds = dst.GetSize();
+    for(int y = 0; y < ds.cy; ++y) {
+        const int y0 = y * ss.cy / ds.cy;
+        const int y1 = max(y0 + 1, (y + 1) * ss.cy / ds.cy);
+        RGBA* t = dst[y];
+        for(int x = 0; x < ds.cx; ++x, ++t) {
+            const int x0 = x * ss.cx / ds.cx;
+            const int x1 = max(x0 + 1, (x + 1) * ss.cx / ds.cx);
+            dword r = 0, g = 0, b = 0, a = 0;
+            for(int sy = y0; sy < y1; ++sy) {
+                const RGBA* s = src[sy];
+                for(int sx = x0; sx < x1; ++sx) {
+                    r += s[sx].r; g += s[sx].g; b += s[sx].b; a += s[sx].a;
+                }
+            }
+            const dword n = (y1 - y0) * (x1 - x0);
+            t->r = (byte)((r + n / 2) / n);
+            t->g = (byte)((g + n / 2) / n);
+            t->b = (byte)((b + n / 2) / n);
+            t->a = (byte)((a + n / 2) / n);
+        }
+    }
+}
+
+void GalleryCtrl::SetAdaptiveQuality(bool b)
+{
+    if(adaptive_quality == b) return;
+    adaptive_quality = b;
+    fast_scroll = false;
+    KillTimeCallback(TIMEID_SETTLE);
+    Refresh();
+}
+
+void GalleryCtrl::NoteScroll(int dx, int dy)
+{
+    const int64 now = usecs();
+    const double dt = max((now - last_scroll_us) / 1e6, 1e-3);
+    const double v  = sqrt((double)dx * dx + (double)dy * dy) / dt;
+    last_scroll_us  = now;
+    scroll_speed    = dt > 0.25 ? v : 0.5 * scroll_speed + 0.5 * v;   // restart after a pause
+
+    if(!adaptive_quality)
+        return;
+    if(scroll_speed > fast_scroll_speed)
+        fast_scroll = true;
+    if(fast_scroll)
+        SetTimeCallback(120, [this] { SettleScroll(); }, TIMEID_SETTLE);
+}
+
+void GalleryCtrl::SettleScroll()
+{
+    fast_scroll  = false;
+    scroll_speed = 0;
+    Refresh();                               // labels, badges, hover come back
+    Schedule(TASK_REFINE);
+}
+
+// Builds one missing / stale mip for a visible tile (TASK_REFINE slice).
+bool GalleryCtrl::RefineSlice()
+{
+    if(fast_scroll)
+        return false;                        // rescheduled by SettleScroll()
+    const int end = min((paint_last_row + 1) * cols, items.GetCount());
+    for(int i = max(0, paint_first_row * cols); i < end; ++i) {
+        GalleryItem& it = items[i];
+        if(it.status != ThumbStatus::Ok || it.thumb.IsEmpty())
+            continue;
+        const Size dst = ThumbDrawSize(it.thumb.GetSize(), ImageRect(TileRect(i)));
+        if(dst.cx <= 0 || dst.cy <= 0 || it.thumb_mip.GetSize() == dst)
+            continue;
+        const Size src = it.thumb.GetSize();
+        if(it.thumb_mip.GetSerialId() != it.thumb.GetSerialId())
+            TilePool::Recycle(it.thumb_mip);     // stale size: back to the pool
+        if(dst == src)
+            it.thumb_mip = it.thumb;
+        else
+        if(dst.cx <= src.cx && dst.cy <= src.cy) {
+            ImageBuffer ib;
+            TilePool::Take(ib, dst);
+            s_shrink(it.thumb, ib);
+            it.thumb_mip = ib;
+        }
+        else
+            it.thumb_mip = RescaleFilter(it.thumb, dst, FILTER_BICUBIC_MITCHELL);
+        NoteLayer(i);
+        DirtyTile(i);
+        return true;
+    }
+    return false;
+}
+
+} // namespace Upp
@@ -0,0 +1,69 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== async completion =======================================================
+// Worker threads and the decode pool push ThumbResults into a lock-free queue.
+// Only the push that finds the queue empty posts to the GUI thread, where the
+// results are applied as TASK_RESULTS slices of the idle scheduler (Idle.cpp):
+// within the frame budget, repainting just the affected tiles.
+
+void GalleryCtrl::PushResult(ThumbResult& r)
+{
+    done_queue.Push(pick(r));
+    if(done_count.fetch_add(1, std::memory_order_acq_rel) == 0) {
+        std::shared_ptr<bool> a = alive;
+        PostCallback([this, a] { if(*a) Schedule(TASK_RESULTS); });
+    }
+}
+
+void GalleryCtrl::PostThumb(int index, Image img, const String& key)
+{
+    ThumbResult r;
+    r.index = index;
+    r.img   = pick(img);
+    r.key   = key;
+    PushResult(r);
+}
+
+void GalleryCtrl::PostThumbStatus(int index, ThumbStatus s)
+{
+    ThumbResult r;
+    r.index  = index;
+    r.status = s;
+    PushResult(r);
+}
+
+bool GalleryCtrl::DrainSlice()
+{
+    enum { SLICE = 16 };
+    int n = 0;
+    ThumbResult r;
+    while(n < SLICE && done_queue.Pop(r)) {
+        n++;
+        if(r.gen >= 0 && r.gen != item_gen) {
+            const int q = gen_remap.Find(r.gen);
+            if(q < 0 || r.index < 0 || r.index >= gen_remap[q].GetCount())
+                continue;                   // cleared since submission
+            r.index = gen_remap[q][r.index];  // reordered since submission
+        }
+        GalleryItem* it = TryItem(r.index);
+        if(!it)
+            continue;
+        if(r.cancelled || r.unavailable) {      // pool stopped or has no worker: decode here
+            const bool ok = SetThumbShared(r.index, r.key) || DecodeThumbHere(r.index, r.path, r.key);
+            MarkStatus(r.index, ok ? ThumbStatus::Ok : ThumbStatus::Error);
+            DirtyTile(r.index);
+            continue;
+        }
+        if(r.status == ThumbStatus::Ok && !r.img.IsEmpty())
+            AssignThumb(*it, r.img, r.key);
+        MarkStatus(r.index, r.status);
+        DirtyTile(r.index);
+    }
+    // a producer between its two stores is counted but not yet poppable:
+    // keep the task alive until the count says the queue is really empty
+    return done_count.fetch_sub(n, std::memory_order_acq_rel) - n > 0;
+}
+
+} // namespace Upp
@@ -0,0 +1,147 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== badge layer ============================================================
+// Rules resolve to slots in a single atlas image (one square per glyph at the
+// current badge size). Paint() only queues {pos, slot} records per tile; the
+// whole batch is blitted from the atlas after the tile pass. Replacing a
+// registered glyph bumps GlyphGeneration(), and the atlas is rebuilt before it
+// is next drawn (slots depend on the rules only, so queued records stay valid).
+
+int GalleryCtrl::BadgeSize() const
+{
+    return max(8, ZoomSteps()[zoom_i] / 5);
+}
+
+int GalleryCtrl::AddBadge(BadgeSource src, unsigned key, int glyph, BadgeCorner corner)
+{
+    BadgeRule& r = badge_rules.Add();
+    r.source = src;
+    r.key    = key;
+    r.glyph  = glyph;
+    r.corner = corner;
+    BuildBadgeAtlas();
+    Refresh();
+    return badge_rules.GetCount() - 1;
+}
+
+void GalleryCtrl::ClearBadges()
+{
+    badge_rules.Clear();
+    BuildBadgeAtlas();
+    Refresh();
+}
+
+void GalleryCtrl::SetItemBadges(int index, dword bits)
+{
+    if(auto* it = TryItem(index)) { it->badges = bits; Refresh(); }
+}
+
+dword GalleryCtrl::GetItemBadges(int index) const
+{
+    const auto* it = TryItem(index);
+    return it ? it->badges : 0;
+}
+
+void GalleryCtrl::SetBadgeMinZoom(int zi)
+{
+    zi = clamp(zi, 0, ZoomStepCount());
+    if(badge_min_zoom == zi) return;
+    badge_min_zoom = zi;
+    Refresh();
+}
+
+void GalleryCtrl::BuildBadgeAtlas()
+{
+    const int bs = BadgeSize();
+
+    VectorMap<int, int> slots;             // glyph id -> atlas slot
+    auto slot_of = [&](int g) {
+        if(g < 0) return -1;
+        int q = slots.Find(g);
+        if(q < 0) { q = slots.GetCount(); slots.Add(g, q); }
+        return slots[q];
+    };
+    for(int b = 0; b < 32; ++b)
+        flag_slot[b] = slot_of(flag_glyph[b]);
+    for(BadgeRule& r : badge_rules)
+        r.slot = slot_of(r.glyph);
+
+    badge_atlas_size = bs;
+    badge_atlas_gen  = GlyphGeneration();
+    if(slots.IsEmpty()) {
+        badge_atlas = Image();
+        return;
+    }
+
+    ImageBuffer ib(bs * slots.GetCount(), bs);
+    for(int i = 0; i < slots.GetCount(); ++i) {
+        const Image& g = Glyph(slots.GetKey(i), bs);
+        const Size gsz = g.GetSize();
+        for(int y = 0; y < bs; ++y) {
+            RGBA* t = ib[y] + i * bs;
+            if(y < gsz.cy)
+                memcpy(t, g[y], min(bs, gsz.cx) * sizeof(RGBA));
+            else
+                memset(t, 0, bs * sizeof(RGBA));
+        }
+    }
+    badge_atlas = ib;
+}
+
+void GalleryCtrl::QueueBadges(const GalleryItem& it, const Rect& ri)
+{
+    const int bs   = badge_atlas_size;
+    const int step = bs + 2;
+    const Rect d   = ri.Deflated(3);
+    int n[4] = { 0, 0, 0, 0 };             // badges placed per corner
+
+    auto put = [&](BadgeCorner c, int slot) {
+        if(slot < 0) return;
+        const int k = (int)c;
+        const bool right  = c == BadgeCorner::TopRight    || c == BadgeCorner::BottomRight;
+        const bool bottom = c == BadgeCorner::BottomLeft  || c == BadgeCorner::BottomRight;
+        BadgeDraw& b = badge_batch.Add();
+        b.x    = right  ? d.right - bs - n[k] * step : d.left + n[k] * step;
+        b.y    = bottom ? d.bottom - bs : d.top;
+        b.slot = slot;
+        n[k]++;
+    };
+
+    for(const BadgeRule& r : badge_rules) {
+        switch(r.source) {
+        case BadgeSource::Status:
+            if((unsigned)it.status == r.key)
+                put(r.corner, r.slot);
+            break;
+        case BadgeSource::Flag: {
+            const unsigned hit = (unsigned)it.flags & r.key;
+            if(!hit) break;
+            int slot = r.slot;
+            for(int b = 0; b < 32 && slot < 0; ++b)
+                if(hit & (1u << b))
+                    slot = flag_slot[b];
+            put(r.corner, slot);
+            break;
+        }
+        case BadgeSource::Custom:
+            if(r.key < 32 && (it.badges & (1u << r.key)))
+                put(r.corner, r.slot);
+            break;
+        }
+    }
+}
+
+void GalleryCtrl::PaintBadges(Draw& w)
+{
+    if(badge_atlas_gen != GlyphGeneration())
+        BuildBadgeAtlas();                 // a registered glyph was replaced
+    const int bs = badge_atlas_size;
+    if(!badge_atlas.IsEmpty())
+        for(const BadgeDraw& b : badge_batch)
+            w.DrawImage(b.x, b.y, badge_atlas, RectC(b.slot * bs, 0, bs, bs));
+    badge_batch.SetCount(0);               // keep capacity for the next frame
+}
+
+} // namespace Upp
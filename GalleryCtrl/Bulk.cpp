@@ -0,0 +1,123 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== bulk mutators ==========================================================
+// Range, index-list and bitset variants of the per-item setters. State and
+// indexes are updated in one pass through MarkStatus / MarkFlags /
+// MarkFiltered, and only the band of rows between the first and last touched
+// item is invalidated, once, clipped to the view.
+
+template <class F>
+static void s_each(int from, int count, int n, int& lo, int& hi, F f)
+{
+    const int end = min(n, from + max(count, 0));
+    for(int i = max(0, from); i < end; ++i)
+        f(i);
+    if(max(0, from) < end) {
+        lo = min(lo, max(0, from));
+        hi = max(hi, end - 1);
+    }
+}
+
+template <class F>
+static void s_each(const Vector<int>& indices, int n, int& lo, int& hi, F f)
+{
+    for(int i : indices)
+        if(i >= 0 && i < n) {
+            f(i);
+            lo = min(lo, i);
+            hi = max(hi, i);
+        }
+}
+
+template <class F>
+static void s_each(const PackedBits& which, int n, int& lo, int& hi, F f)
+{
+    for(int i = which.Next(0); i >= 0 && i < n; i = which.Next(i + 1)) {
+        f(i);
+        lo = min(lo, i);
+        hi = max(hi, i);
+    }
+}
+
+void GalleryCtrl::RefreshSpan(int lo, int hi)
+{
+    if(lo > hi)
+        return;
+    Rect r(0, TileRect(lo).top - Gap(), GetSize().cx, TileRect(hi).bottom + Gap());
+    r.Offset(0, -scroll_y);
+    r &= GetSize();
+    if(!r.IsEmpty())
+        Refresh(r);
+}
+
+static DataFlags s_merge(DataFlags was, DataFlags f, DataFlags mask)
+{
+    return DataFlags((was & ~mask) | (f & mask));
+}
+
+void GalleryCtrl::SetThumbStatus(int from, int count, ThumbStatus s)
+{
+    int lo = INT_MAX, hi = -1;
+    s_each(from, count, items.GetCount(), lo, hi, [&](int i) { MarkStatus(i, s); });
+    RefreshSpan(lo, hi);
+}
+
+void GalleryCtrl::SetThumbStatus(const Vector<int>& indices, ThumbStatus s)
+{
+    int lo = INT_MAX, hi = -1;
+    s_each(indices, items.GetCount(), lo, hi, [&](int i) { MarkStatus(i, s); });
+    RefreshSpan(lo, hi);
+}
+
+void GalleryCtrl::SetThumbStatus(const PackedBits& which, ThumbStatus s)
+{
+    int lo = INT_MAX, hi = -1;
+    s_each(which, items.GetCount(), lo, hi, [&](int i) { MarkStatus(i, s); });
+    RefreshSpan(lo, hi);
+}
+
+void GalleryCtrl::SetDataFlags(int from, int count, DataFlags f, DataFlags mask)
+{
+    int lo = INT_MAX, hi = -1;
+    s_each(from, count, items.GetCount(), lo, hi, [&](int i) { MarkFlags(i, s_merge(items[i].flags, f, mask)); });
+    RefreshSpan(lo, hi);
+}
+
+void GalleryCtrl::SetDataFlags(const Vector<int>& indices, DataFlags f, DataFlags mask)
+{
+    int lo = INT_MAX, hi = -1;
+    s_each(indices, items.GetCount(), lo, hi, [&](int i) { MarkFlags(i, s_merge(items[i].flags, f, mask)); });
+    RefreshSpan(lo, hi);
+}
+
+void GalleryCtrl::SetDataFlags(const PackedBits& which, DataFlags f, DataFlags mask)
+{
+    int lo = INT_MAX, hi = -1;
+    s_each(which, items.GetCount(), lo, hi, [&](int i) { MarkFlags(i, s_merge(items[i].flags, f, mask)); });
+    RefreshSpan(lo, hi);
+}
+
+void GalleryCtrl::SetFiltered(int from, int count, bool filtered_out)
+{
+    int lo = INT_MAX, hi = -1;
+    s_each(from, count, items.GetCount(), lo, hi, [&](int i) { MarkFiltered(i, filtered_out); });
+    RefreshSpan(lo, hi);
+}
+
+void GalleryCtrl::SetFiltered(const Vector<int>& indices, bool filtered_out)
+{
+    int lo = INT_MAX, hi = -1;
+    s_each(indices, items.GetCount(), lo, hi, [&](int i) { MarkFiltered(i, filtered_out); });
+    RefreshSpan(lo, hi);
+}
+
+void GalleryCtrl::SetFiltered(const PackedBits& which, bool filtered_out)
+{
+    int lo = INT_MAX, hi = -1;
+    s_each(which, items.GetCount(), lo, hi, [&](int i) { MarkFiltered(i, filtered_out); });
+    RefreshSpan(lo, hi);
+}
+
+} // namespace Upp
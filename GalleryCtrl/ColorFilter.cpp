@@ -0,0 +1,131 @@
+#include "GalleryCtrl.h"
+
+#ifdef CPU_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Upp {
+
+// ==== color filter ===========================================================
+// Each thumbnail gets a 64-bin HSV histogram (12 hues x 5 tones + 4 grays, as
+// 0..255 shares that sum to ~255) in the TASK_AVG feature pass, stored as one
+// contiguous byte column. A color query is itself a histogram and the score is
+// the histogram intersection: per item four min / sum-of-absolute-differences
+// instructions. Scores are computed per 64-item word across cores and the new
+// filter bits are applied as one diff against the old ones.
+
+enum { HIST_HUES = 12, HIST_TONES = 5, HIST_GRAY = HIST_HUES * HIST_TONES };
+
+static int s_hist_bin(int r, int g, int b)
+{
+    const int mx = max(r, max(g, b));
+    const int mn = min(r, min(g, b));
+    const int c  = mx - mn;
+    if(mx < 24 || c * 100 < 15 * mx)                     // dark or unsaturated
+        return HIST_GRAY + mx * 4 / 256;
+    int h;                                                // hue 0..359
+    if(mx == r)      h = (60 * (g - b) / c + 360) % 360;
+    else if(mx == g) h = 60 * (b - r) / c + 120;
+    else             h = 60 * (r - g) / c + 240;
+    // shift by half a bin so pure red / green / blue sit in the middle of theirs
+    const int hue  = (h + 15) % 360 * HIST_HUES / 360;
+    const int tone = mx < 90 ? 0 : 1 + 2 * (c * 2 > mx) + (mx >= 180);
+    return hue * HIST_TONES + tone;
+}
+
+static void s_color_histogram(const Image& img, byte* out)
+{
+    const Size sz = img.GetSize();
+    int cnt[GalleryCtrl::HIST_BINS] = {};
+    const int step = 1 + (int)((int64)sz.cx * sz.cy >> 14);   // ~16k samples
+    int n = 0;
+    for(int y = 0; y < sz.cy; y += step) {
+        const RGBA* s = img[y];
+        for(int x = 0; x < sz.cx; ++x)
+            if(s[x].a) {
+                const int a = s[x].a;                          // unpremultiply
+                cnt[s_hist_bin(s[x].r * 255 / a, s[x].g * 255 / a, s[x].b * 255 / a)]++;
+                n++;
+            }
+    }
+    for(int k = 0; k < GalleryCtrl::HIST_BINS; ++k)
+        out[k] = (byte)(n ? (cnt[k] * 255 + n / 2) / n : 0);
+}
+
+static int s_intersect(const byte* h, const byte* q)
+{
+#ifdef CPU_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for(int k = 0; k < GalleryCtrl::HIST_BINS; k += 16) {
+        const __m128i m = _mm_min_epu8(_mm_loadu_si128((const __m128i*)(h + k)),
+                                       _mm_loadu_si128((const __m128i*)(q + k)));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(m, zero));
+    }
+    return _mm_cvtsi128_si32(acc) + _mm_extract_epi16(acc, 4);
+#else
+    int s = 0;
+    for(int k = 0; k < GalleryCtrl::HIST_BINS; ++k)
+        s += min(h[k], q[k]);
+    return s;
+#endif
+}
+
+void GalleryCtrl::ColorHistogram(const Image& img, byte* out)
+{
+    s_color_histogram(img, out);
+}
+
+Vector<byte> GalleryCtrl::GetColorHistogram(int index) const
+{
+    Vector<byte> h;
+    if(HasPerceptualHash(index))                 // features are computed together
+        h.Append(color_hist, index * HIST_BINS, HIST_BINS);
+    return h;
+}
+
+void GalleryCtrl::SetColorFilter(Color c, int min_score)
+{
+    // query: the color's bin, its neighbouring hues and other tones of that hue partly
+    byte q[HIST_BINS] = {};
+    const int bin = s_hist_bin(c.GetR(), c.GetG(), c.GetB());
+    if(bin >= HIST_GRAY)
+        q[bin] = 255;
+    else {
+        const int hue = bin / HIST_TONES, tone = bin % HIST_TONES;
+        for(int t = 0; t < HIST_TONES; ++t)
+            q[hue * HIST_TONES + t] = t == tone ? 255 : 128;
+        for(int d = -1; d <= 1; d += 2)
+            q[(hue + d + HIST_HUES) % HIST_HUES * HIST_TONES + tone] = 96;
+    }
+    ApplyColorFilter(q, min_score);
+}
+
+void GalleryCtrl::SetColorFilterLike(int index, int min_score)
+{
+    if(!HasPerceptualHash(index))
+        return;
+    byte q[HIST_BINS];
+    memcpy(q, &color_hist[index * HIST_BINS], HIST_BINS);
+    ApplyColorFilter(q, min_score);
+}
+
+void GalleryCtrl::ApplyColorFilter(const byte* q, int min_score)
+{
+    // new filtered_out bits, one 64-item word per task so writes never share a word
+    const int n = items.GetCount();
+    PackedBits out;
+    out.SetCount(n);
+    uint64* word = out.Words();
+    CoFor(out.WordCount(), [&](int wi) {
+        uint64 w = 0;
+        const int end = min(n, (wi + 1) * 64);
+        for(int i = wi * 64; i < end; ++i)
+            if(!phash_bits.Get(i) || s_intersect(&color_hist[i * HIST_BINS], q) < min_score)
+                w |= (uint64)1 << (i & 63);      // no features yet counts as no match
+        word[wi] = w;
+    });
+    ApplyFiltered(out);                          // only the differences (Facets.cpp)
+}
+
+} // namespace Upp
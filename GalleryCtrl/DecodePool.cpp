@@ -0,0 +1,474 @@
+#include "GalleryCtrl.h"
+
+#ifdef PLATFORM_POSIX
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Upp {
+
+// ==== out-of-process decode pool =============================================
+// Protocol (one line per message over the worker's stdin / stdout):
+//   parent -> worker   "<job> <slot> <path>\n"
+//   worker -> parent   "<job> ok <cx> <cy>\n"  (pixels are in <slot>)
+//                      "<job> err\n"
+// Every worker owns a shared-memory block of SLOTS slots of max_edge^2 RGBA,
+// so up to SLOTS requests are pipelined per worker and pixel data never goes
+// through the pipe. A worker that dies or exceeds the timeout takes only the
+// job at the head of its queue down with it; the rest are requeued and the
+// worker is restarted. A worker that cannot be started, or dies right after
+// starting, is retried with a growing delay; while no worker is up, queued
+// jobs go back to their controls marked 'unavailable' and are decoded there.
+
+static const char WORKER_SWITCH[] = "--gallery-decode-worker";
+
+namespace {
+
+struct SharedBlock {
+    byte*  ptr  = nullptr;
+    size_t size = 0;
+#ifdef PLATFORM_WIN32
+    HANDLE map  = NULL;
+#else
+    String name;
+    bool   owner = false;
+#endif
+
+    bool Map(const String& nm, size_t sz, bool create);
+    void Close();
+    ~SharedBlock() { Close(); }
+};
+
+bool SharedBlock::Map(const String& nm, size_t sz, bool create)
+{
+    Close();
+#ifdef PLATFORM_WIN32
+    const String wn = "Local\\" + nm;
+    map = create ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                      (DWORD)((uint64)sz >> 32), (DWORD)sz, ~wn)
+                 : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, ~wn);
+    if(map)
+        ptr = (byte*)MapViewOfFile(map, FILE_MAP_ALL_ACCESS, 0, 0, sz);
+#else
+    name  = "/" + nm;
+    owner = create;
+    const int fd = shm_open(name, create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR, 0600);
+    if(fd >= 0) {
+        if(!create || ftruncate(fd, (off_t)sz) == 0) {
+            void* p = mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ptr = p == MAP_FAILED ? nullptr : (byte*)p;
+        }
+        close(fd);
+    }
+#endif
+    size = sz;
+    if(!ptr) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SharedBlock::Close()
+{
+#ifdef PLATFORM_WIN32
+    if(ptr) UnmapViewOfFile(ptr);
+    if(map) CloseHandle(map);
+    map = NULL;
+#else
+    if(ptr) munmap(ptr, size);
+    if(owner) shm_unlink(name);
+    owner = false;
+#endif
+    ptr  = nullptr;
+    size = 0;
+}
+
+int s_pid()
+{
+#ifdef PLATFORM_WIN32
+    return (int)GetCurrentProcessId();
+#else
+    return (int)getpid();
+#endif
+}
+
+Size s_fit_edge(Size sz, int edge)
+{
+    if(max(sz.cx, sz.cy) <= edge)
+        return sz;
+    return sz.cx >= sz.cy ? Size(edge, max(1, sz.cy * edge / sz.cx))
+                          : Size(max(1, sz.cx * edge / sz.cy), edge);
+}
+
+struct DecodeJob : Moveable<DecodeJob> {
+    int64  id = 0, owner = 0;
+    int    index = -1, gen = 0;
+    String path, key;
+};
+
+struct Inflight : Moveable<Inflight> {
+    DecodeJob job;
+    int       slot = 0;
+};
+
+struct DecodeWorker {
+    LocalProcess     proc;
+    SharedBlock      shm;
+    String           out;              // stdout not yet split into lines
+    Vector<Inflight> fifo;             // sent, in order; fifo[0] is being decoded
+    dword            slot_free = 0;
+    int              head_since = 0;   // msecs() when fifo[0] became head
+    int              started = 0;      // msecs() of the last spawn
+    int              retry_at = 0;     // msecs() of the next spawn attempt (dead worker)
+    int              backoff = 0;      // current retry delay, ms
+    bool             alive = false;
+};
+
+struct PoolState {
+    enum { SLOTS = 4 };
+
+    Mutex                lock;         // queue, live
+    BiVector<DecodeJob>  queue;
+    ArrayMap<int64, DecodePool::Sink> live;
+
+    Array<DecodeWorker>  workers;      // pump thread only (while running)
+    Thread               thread;
+    std::atomic<bool>    quit { false };
+    std::atomic<bool>    running { false };
+    std::atomic<int>     up { 0 };     // workers alive
+    int                  timeout_ms = 5000;
+    int                  max_edge = 256;
+    int                  spawn_seq = 0;
+    int64                next_job = 0;
+    int64                next_owner = 0;
+    std::atomic<int64>   decoded { 0 }, failed { 0 }, restarts { 0 };
+
+    size_t SlotBytes() const { return (size_t)max_edge * max_edge * sizeof(RGBA); }
+
+    bool Spawn(DecodeWorker& w);
+    void Backoff(DecodeWorker& w);
+    void Deliver(const DecodeJob& j, Image img, bool ok, bool cancelled = false, bool unavailable = false);
+    void Requeue(DecodeWorker& w, int from);
+    void Restart(DecodeWorker& w);
+    bool Feed();
+    bool Service(DecodeWorker& w);
+    void Run();
+    void Shutdown();
+
+    ~PoolState() { Shutdown(); }
+};
+
+PoolState& s_pool()
+{
+    static PoolState p;
+    return p;
+}
+
+bool PoolState::Spawn(DecodeWorker& w)
+{
+    w.proc.Kill();
+    w.out.Clear();
+    w.fifo.Clear();
+    w.slot_free = (1u << SLOTS) - 1;
+    const String name = Format("gallery-decode-%d-%d", s_pid(), ++spawn_seq);
+    w.alive = w.shm.Map(name, SlotBytes() * SLOTS, true)
+           && w.proc.Start("\"" + GetExeFilePath() + "\" " + WORKER_SWITCH + " " + name + " "
+                           + AsString((int)SLOTS) + " " + AsString(max_edge));
+    w.started = msecs();
+    if(!w.alive)
+        Backoff(w);
+    return w.alive;
+}
+
+// Takes the worker down until retry_at; the delay doubles up to 5 s and is
+// reset by the first reply of a healthy worker.
+void PoolState::Backoff(DecodeWorker& w)
+{
+    w.proc.Kill();
+    w.shm.Close();
+    w.fifo.Clear();                                  // already delivered or requeued
+    w.alive    = false;
+    w.backoff  = clamp(2 * w.backoff, 100, 5000);
+    w.retry_at = msecs() + w.backoff;
+}
+
+void PoolState::Deliver(const DecodeJob& j, Image img, bool ok, bool cancelled, bool unavailable)
+{
+    if(ok) decoded++;
+    else if(!cancelled && !unavailable) failed++;
+    ThumbResult r;
+    r.index     = j.index;
+    r.gen       = j.gen;
+    r.path      = j.path;
+    r.key       = j.key;
+    r.img       = pick(img);
+    r.status    = ok ? ThumbStatus::Ok : ThumbStatus::Error;
+    r.cancelled = cancelled;
+    r.unavailable = unavailable;
+    Mutex::Lock __(lock);                            // Release() waits for us
+    const int q = live.Find(j.owner);
+    if(q >= 0)
+        live[q](r);
+}
+
+void PoolState::Requeue(DecodeWorker& w, int from)
+{
+    Mutex::Lock __(lock);
+    for(int i = w.fifo.GetCount() - 1; i >= from; --i)
+        queue.AddHead(pick(w.fifo[i].job));
+}
+
+// Head job is blamed for the crash / hang; everything behind it is retried.
+void PoolState::Restart(DecodeWorker& w)
+{
+    if(w.fifo.GetCount())
+        Deliver(w.fifo[0].job, Image(), false);
+    Requeue(w, 1);
+    restarts++;
+    if(msecs(w.started) < 1000)
+        Backoff(w);                                  // dies on startup: do not spin
+    else
+        Spawn(w);
+}
+
+bool PoolState::Feed()
+{
+    bool any = false;
+    for(bool progress = true; progress;) {           // round robin, one job per pass
+        progress = false;
+        for(DecodeWorker& w : workers) {
+            if(!w.alive || !w.slot_free)
+                continue;
+            DecodeJob j;
+            {
+                Mutex::Lock __(lock);
+                if(queue.IsEmpty())
+                    return any;
+                j = queue.PopHead();
+            }
+            int slot = 0;
+            while(!(w.slot_free & (1u << slot))) ++slot;
+            w.slot_free &= ~(1u << slot);
+            if(w.fifo.IsEmpty())
+                w.head_since = msecs();
+            w.proc.Write(AsString(j.id) + " " + AsString(slot) + " " + j.path + "\n");
+            Inflight& f = w.fifo.Add();
+            f.job  = pick(j);
+            f.slot = slot;
+            progress = any = true;
+        }
+    }
+    return any;
+}
+
+bool PoolState::Service(DecodeWorker& w)
+{
+    bool any = false;
+    String chunk;
+    if(w.proc.Read(chunk) && chunk.GetCount()) {
+        w.out.Cat(chunk);
+        any = true;
+    }
+
+    for(int q; (q = w.out.Find('\n')) >= 0;) {
+        const Vector<String> f = Split(TrimRight(w.out.Left(q)), ' ');
+        w.out.Remove(0, q + 1);
+        if(f.GetCount() < 2 || w.fifo.IsEmpty() || ScanInt64(f[0]) != w.fifo[0].job.id)
+            continue;                                // decoder noise on stdout
+        Inflight& h = w.fifo[0];
+        w.backoff = 0;                               // it works
+        if(f[1] == "ok" && f.GetCount() >= 4) {
+            const Size sz(ScanInt(f[2]), ScanInt(f[3]));
+            Image img;
+            if(sz.cx > 0 && sz.cy > 0 && (size_t)sz.cx * sz.cy * sizeof(RGBA) <= SlotBytes()) {
+                ImageBuffer ib;
+                TilePool::Take(ib, sz);
+                memcpy(~ib, w.shm.ptr + h.slot * SlotBytes(), sz.cx * sz.cy * sizeof(RGBA));
+                img = ib;
+            }
+            Deliver(h.job, img, !img.IsEmpty());
+        }
+        else
+            Deliver(h.job, Image(), false);
+        w.slot_free |= 1u << h.slot;
+        w.fifo.Remove(0);
+        w.head_since = msecs();
+    }
+
+    if(!w.proc.IsRunning()) {
+        Restart(w);
+        return true;
+    }
+    if(w.fifo.GetCount() && msecs(w.head_since) > timeout_ms) {
+        w.proc.Kill();
+        Restart(w);
+        return true;
+    }
+    return any;
+}
+
+void PoolState::Run()
+{
+    while(!quit) {
+        int n = 0;
+        for(DecodeWorker& w : workers) {
+            if(!w.alive && msecs() - w.retry_at >= 0)
+                Spawn(w);
+            n += w.alive;
+        }
+        up = n;
+        if(!n) {                                     // none can run: controls decode in-process
+            Vector<DecodeJob> rest;
+            {
+                Mutex::Lock __(lock);
+                while(queue.GetCount())
+                    rest.Add(queue.PopHead());
+            }
+            for(const DecodeJob& j : rest)
+                Deliver(j, Image(), false, false, true);
+        }
+        bool busy = Feed();
+        for(DecodeWorker& w : workers)
+            if(w.alive)
+                busy = Service(w) || busy;
+        if(!busy)
+            Sleep(1);
+    }
+}
+
+void PoolState::Shutdown()
+{
+    if(!running)
+        return;
+    quit = true;
+    thread.Wait();
+    running = false;
+    up = 0;
+    for(DecodeWorker& w : workers) {
+        w.proc.Kill();
+        for(const Inflight& f : w.fifo)
+            Deliver(f.job, Image(), false, true);
+        w.shm.Close();
+    }
+    workers.Clear();
+    Vector<DecodeJob> rest;
+    {
+        Mutex::Lock __(lock);
+        while(queue.GetCount())
+            rest.Add(queue.PopHead());
+    }
+    for(const DecodeJob& j : rest)
+        Deliver(j, Image(), false, true);
+}
+
+}
+
+// ---- worker side ------------------------------------------------------------
+bool DecodePool::WorkerMain()
+{
+    const Vector<String>& cmd = CommandLine();
+    if(cmd.GetCount() < 4 || cmd[0] != WORKER_SWITCH)
+        return false;
+    const int    slots = max(1, ScanInt(cmd[2]));
+    const int    edge  = max(1, ScanInt(cmd[3]));
+    const size_t slot_bytes = (size_t)edge * edge * sizeof(RGBA);
+
+    SharedBlock shm;
+    if(!shm.Map(cmd[1], slot_bytes * slots, false))
+        return true;
+
+    char line[8192];
+    while(fgets(line, sizeof(line), stdin)) {
+        const String l = TrimRight(String(line));
+        const int a = l.Find(' ');
+        const int b = a < 0 ? -1 : l.Find(' ', a + 1);
+        if(b < 0)
+            continue;
+        const String job  = l.Left(a);
+        const int    slot = clamp(ScanInt(l.Mid(a + 1, b - a - 1)), 0, slots - 1);
+
+        Image img = StreamRaster::LoadFileAny(l.Mid(b + 1));
+        if(img.IsEmpty())
+            printf("%s err\n", ~job);
+        else {
+            const Size sz = s_fit_edge(img.GetSize(), edge);
+            if(sz != img.GetSize())
+                img = Rescale(img, sz);
+            memcpy(shm.ptr + slot * slot_bytes, ~img, img.GetLength() * sizeof(RGBA));
+            printf("%s ok %d %d\n", ~job, sz.cx, sz.cy);
+        }
+        fflush(stdout);
+    }
+    return true;
+}
+
+// ---- parent side ------------------------------------------------------------
+void DecodePool::Start(int workers, int timeout_ms, int max_edge)
+{
+    Stop();
+    PoolState& p = s_pool();
+    p.timeout_ms = max(timeout_ms, 100);
+    p.max_edge   = clamp(max_edge, 16, 4096);
+    p.quit       = false;
+    const int n  = workers > 0 ? workers : CPU_Cores();
+    int up = 0;
+    for(int i = 0; i < n; ++i)
+        up += p.Spawn(p.workers.Add());
+    p.up      = up;
+    p.running = true;
+    p.thread.Run([&p] { p.Run(); });
+}
+
+void DecodePool::Stop()              { s_pool().Shutdown(); }
+bool DecodePool::IsRunning()         { return s_pool().running; }
+int  DecodePool::GetWorkers()        { return s_pool().up; }
+int64 DecodePool::GetDecoded()       { return s_pool().decoded; }
+int64 DecodePool::GetFailed()        { return s_pool().failed; }
+int64 DecodePool::GetRestarts()      { return s_pool().restarts; }
+
+int64 DecodePool::NewOwner(Sink sink)
+{
+    PoolState& p = s_pool();
+    Mutex::Lock __(p.lock);
+    const int64 id = ++p.next_owner;
+    p.live.Add(id, pick(sink));
+    return id;
+}
+
+void DecodePool::Submit(int64 owner, int index, int gen, const String& path, const String& key)
+{
+    PoolState& p = s_pool();
+    Mutex::Lock __(p.lock);
+    DecodeJob& j = p.queue.AddTail();
+    j.id    = ++p.next_job;
+    j.owner = owner;
+    j.index = index;
+    j.gen   = gen;
+    j.path  = path;
+    j.key   = key;
+}
+
+void DecodePool::Cancel(int64 owner)
+{
+    PoolState& p = s_pool();
+    Mutex::Lock __(p.lock);
+    BiVector<DecodeJob> keep;
+    while(p.queue.GetCount()) {
+        DecodeJob j = p.queue.PopHead();
+        if(j.owner != owner)
+            keep.AddTail(pick(j));
+    }
+    p.queue = pick(keep);
+}
+
+void DecodePool::Release(int64 owner)
+{
+    Cancel(owner);
+    PoolState& p = s_pool();
+    Mutex::Lock __(p.lock);
+    p.live.RemoveKey(owner);
+}
+
+} // namespace Upp
@@ -0,0 +1,148 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== density strip ==========================================================
+// A narrow strip beside the vertical scrollbar, one bucket per pixel row (or
+// per content row when there are fewer), with three lanes: filter matches,
+// flagged and selected items. Buckets are popcounts over the packed bit
+// columns, rebuilt only when the row layout or strip height changes; every
+// Mark*() afterwards adjusts a single bucket.
+
+void GalleryCtrl::SetDensityStrip(bool b)
+{
+    if(density_on == b) return;
+    density_on = b;
+    if(b)
+        AddFrame(density.Width(6));
+    else
+        RemoveFrame(density);
+    Reflow();
+    Refresh();
+}
+
+// bucket b holds the rows r with r * nb / rows == b
+static int s_bucket_row(int b, int nb, int rows)
+{
+    return (int)(((int64)b * rows + nb - 1) / nb);
+}
+
+void GalleryCtrl::DensityDelta(Vector<int>& bucket, int& total, int index, int d)
+{
+    total += d;
+    if(density_cols != cols || density_rows != rows || bucket.IsEmpty())
+        return;                                  // stale; rebuilt on next paint
+    bucket[(int)((int64)(index / cols) * bucket.GetCount() / rows)] += d;
+    if(density_on)
+        density.Refresh();
+}
+
+void GalleryCtrl::MarkSelected(int index, bool b)
+{
+    items[index].selected = b;
+    if(sel_bits.Set(index, b))
+        DensityDelta(density_sel, density_sel_total, index, b ? 1 : -1);
+}
+
+void GalleryCtrl::MarkFiltered(int index, bool b)
+{
+    items[index].filtered_out = b;
+    if(filt_bits.Set(index, b))
+        DensityDelta(density_filt, density_filt_total, index, b ? 1 : -1);
+}
+
+void GalleryCtrl::MarkFlagged(int index, bool b)
+{
+    if(flag_bits.Set(index, b))
+        DensityDelta(density_flag, density_flag_total, index, b ? 1 : -1);
+}
+
+void GalleryCtrl::RebuildDensity(int nb)
+{
+    nb = rows > 0 ? clamp(nb, 1, rows) : 0;
+    density_cols = cols;
+    density_rows = rows;
+    density_sel.SetCount(nb);
+    density_filt.SetCount(nb);
+    density_flag.SetCount(nb);
+    const int n = items.GetCount();
+    for(int b = 0; b < nb; ++b) {
+        const int a = min(n, s_bucket_row(b, nb, rows) * cols);
+        const int e = min(n, s_bucket_row(b + 1, nb, rows) * cols);
+        density_sel[b]  = sel_bits.Count(a, e);
+        density_filt[b] = filt_bits.Count(a, e);
+        density_flag[b] = flag_bits.Count(a, e);
+    }
+    density_sel_total  = sel_bits.Count();
+    density_filt_total = filt_bits.Count();
+    density_flag_total = flag_bits.Count();
+}
+
+void GalleryCtrl::PaintDensity(Draw& w, Size sz)
+{
+    const RGBA face = SColorFace();
+    if(sz.cx <= 0 || sz.cy <= 0)
+        return;
+    const int nb = rows > 0 ? min(sz.cy, rows) : 0;
+    if(density_cols != cols || density_rows != rows || density_sel.GetCount() != nb)
+        RebuildDensity(sz.cy);
+
+    ImageBuffer ib(sz);
+    Fill(~ib, face, ib.GetLength());
+
+    // lanes left to right; filter matches are shown only while a filter is active
+    struct Lane { const Vector<int>* count; int total; Color color; bool matches; };
+    const Lane lanes[] = {
+        { &density_filt, density_filt_total, Color(60, 160, 90), true  },
+        { &density_flag, density_flag_total, Color(230, 170, 40), false },
+        { &density_sel,  density_sel_total,  SColorHighlight(),   false },
+    };
+    const int n = items.GetCount();
+    for(int li = 0; li < 3; ++li) {
+        const Lane& l = lanes[li];
+        if(l.total == 0)
+            continue;
+        const int x0 = li * sz.cx / 3, x1 = (li + 1) * sz.cx / 3;
+        for(int b = 0; b < nb && x0 < x1; ++b) {
+            const int a = min(n, s_bucket_row(b, nb, rows) * cols);
+            const int e = min(n, s_bucket_row(b + 1, nb, rows) * cols);
+            const int k = l.matches ? (e - a) - (*l.count)[b] : (*l.count)[b];
+            if(k <= 0)
+                continue;
+            const RGBA px = Blend(SColorFace(), l.color, 80 + (int)((int64)175 * k / (e - a)));  // sparse stays visible
+            const int y0 = (int)((int64)b * sz.cy / nb);
+            const int y1 = (int)((int64)(b + 1) * sz.cy / nb);
+            for(int y = y0; y < y1; ++y)
+                Fill(ib[y] + x0, px, x1 - x0);
+        }
+    }
+    w.DrawImage(0, 0, ib);
+}
+
+void GalleryCtrl::DensityJump(int y, int height)
+{
+    if(rows <= 0 || height <= 0)
+        return;
+    const int r = (int)((int64)clamp(y, 0, height - 1) * rows / height);
+    sb.SetY(max(0, r * (CellH() + Gap()) + CellH() / 2 - GetSize().cy / 2));
+    scroll_y = sb.GetY();
+    Refresh();
+}
+
+void GalleryCtrl::DensityStrip::Paint(Draw& w)
+{
+    owner->PaintDensity(w, GetSize());
+}
+
+void GalleryCtrl::DensityStrip::LeftDown(Point p, dword)
+{
+    owner->DensityJump(p.y, GetSize().cy);
+}
+
+void GalleryCtrl::DensityStrip::MouseMove(Point p, dword keyflags)
+{
+    if(keyflags & K_MOUSELEFT)
+        owner->DensityJump(p.y, GetSize().cy);
+}
+
+} // namespace Upp
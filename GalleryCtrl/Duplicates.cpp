@@ -0,0 +1,187 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== near duplicates ========================================================
+// Each thumbnail gets a 64-bit difference hash (dHash: 9 x 8 luma means, one
+// bit per horizontal neighbour pair) in the TASK_AVG feature pass. Lookups use
+// multi-index hashing: the hash is split into four 16-bit chunks, and two
+// hashes within Hamming distance d agree on at least one chunk up to d / 4
+// bits, so candidates come from a handful of counting-sorted chunk tables.
+// Identical hashes are grouped by sorting first, so flat or repeated frames
+// never degrade the chunk tables.
+
+uint64 GalleryCtrl::PerceptualHash(const Image& src)
+{
+    enum { W = 9, H = 8 };
+    if(src.IsEmpty())
+        return 0;
+    const Image img = src.GetWidth() < W || src.GetHeight() < H ? Rescale(src, W, H) : src;
+    const Size sz = img.GetSize();
+
+    // vertical pass accumulates luma per column (vectorizes), horizontal bins once per band
+    Buffer<int>   acc(sz.cx);
+    Buffer<byte>  bin(sz.cx);
+    int           bin_w[W] = {};
+    for(int x = 0; x < sz.cx; ++x) {
+        bin[x] = (byte)(x * W / sz.cx);
+        bin_w[bin[x]]++;
+    }
+    int64 mean[H][W];
+    for(int b = 0; b < H; ++b) {
+        const int y0 = b * sz.cy / H, y1 = (b + 1) * sz.cy / H;
+        Fill(~acc, ~acc + sz.cx, 0);
+        for(int y = y0; y < y1; ++y) {
+            const RGBA* s = img[y];
+            int* a = ~acc;
+            for(int x = 0; x < sz.cx; ++x)
+                a[x] += s[x].r * 77 + s[x].g * 150 + s[x].b * 29;
+        }
+        int64 sum[W] = {};
+        for(int x = 0; x < sz.cx; ++x)
+            sum[bin[x]] += acc[x];
+        for(int c = 0; c < W; ++c)      // scaled means; the bands differ by at most one row
+            mean[b][c] = sum[c] * 4096 / max(1, bin_w[c] * (y1 - y0));
+    }
+
+    uint64 h = 0;
+    for(int r = 0; r < H; ++r)
+        for(int c = 0; c < W - 1; ++c)
+            h = (h << 1) | (mean[r][c] < mean[r][c + 1]);
+    return h;
+}
+
+uint64 GalleryCtrl::GetPerceptualHash(int index) const
+{
+    return HasPerceptualHash(index) ? phash[index] : 0;
+}
+
+bool GalleryCtrl::HasPerceptualHash(int index) const
+{
+    return index >= 0 && index < items.GetCount() && phash_bits.Get(index);
+}
+
+// Four counting-sorted chunk tables over distinct hashes
+struct GalleryCtrl::HashIndex {
+    enum { CHUNKS = 4, KEYS = 65536 };
+    Vector<uint64> hash;                 // distinct hashes, sorted
+    Vector<int>    first;                // items grouped by hash: item[first[u] .. first[u + 1])
+    Vector<int>    item;
+    Vector<int>    start[CHUNKS];        // chunk value -> range in slot[]
+    Vector<int>    slot[CHUNKS];         // distinct hash ids
+
+    static int Chunk(uint64 h, int c) { return (int)(h >> (16 * c)) & 0xffff; }
+
+    void Build(const Vector<uint64>& phash, const PackedBits& valid) {
+        for(int i = valid.Next(0); i >= 0; i = valid.Next(i + 1))
+            item.Add(i);
+        Sort(item, [&](int a, int b) { return phash[a] != phash[b] ? phash[a] < phash[b] : a < b; });
+        for(int k = 0; k < item.GetCount(); ++k)
+            if(k == 0 || phash[item[k]] != hash.Top()) {
+                hash.Add(phash[item[k]]);
+                first.Add(k);
+            }
+        first.Add(item.GetCount());
+        for(int c = 0; c < CHUNKS; ++c) {
+            start[c].SetCount(KEYS + 1, 0);
+            slot[c].SetCount(hash.GetCount());
+            for(uint64 h : hash)
+                start[c][Chunk(h, c) + 1]++;
+            for(int k = 0; k < KEYS; ++k)
+                start[c][k + 1] += start[c][k];
+            Vector<int> at(start[c], 1);
+            for(int u = 0; u < hash.GetCount(); ++u)
+                slot[c][at[Chunk(hash[u], c)]++] = u;
+        }
+    }
+
+    // distinct hash ids within max_dist of h (candidates via chunk radius max_dist / 4)
+    void Query(uint64 h, int max_dist, Vector<int>& out) const {
+        const int r = max_dist / CHUNKS;
+        out.Clear();
+        for(int c = 0; c < CHUNKS; ++c) {
+            const int key = Chunk(h, c);
+            auto probe = [&](int k) {
+                for(int q = start[c][k]; q < start[c][k + 1]; ++q) {
+                    const int u = slot[c][q];
+                    if(Popcount64(hash[u] ^ h) <= max_dist)
+                        out.Add(u);
+                }
+            };
+            probe(key);
+            for(int b1 = 0; b1 < 16 && r >= 1; ++b1) {
+                probe(key ^ (1 << b1));
+                for(int b2 = b1 + 1; b2 < 16 && r >= 2; ++b2)
+                    probe(key ^ (1 << b1) ^ (1 << b2));
+            }
+        }
+        Sort(out);                               // found once per agreeing chunk
+        out.SetCount(int(std::unique(out.begin(), out.end()) - out.begin()));
+    }
+};
+
+Vector<Vector<int>> GalleryCtrl::FindDuplicateGroups(int max_dist)
+{
+    max_dist = clamp(max_dist, 0, 11);
+    HashIndex x;
+    x.Build(phash, phash_bits);
+    const int nu = x.hash.GetCount();
+
+    Vector<Vector<int>> near;
+    near.SetCount(nu);
+    CoFor(nu, [&](int u) { x.Query(x.hash[u], max_dist, near[u]); });
+
+    Vector<int> parent;                          // union-find over distinct hashes
+    parent.SetCount(nu);
+    for(int u = 0; u < nu; ++u)
+        parent[u] = u;
+    auto root = [&](int u) {
+        while(parent[u] != u)
+            u = parent[u] = parent[parent[u]];
+        return u;
+    };
+    for(int u = 0; u < nu; ++u)
+        for(int v : near[u])
+            parent[root(v)] = root(u);
+
+    VectorMap<int, Vector<int>> group;
+    for(int u = 0; u < nu; ++u) {
+        Vector<int>& g = group.GetAdd(root(u));
+        g.Append(x.item, x.first[u], x.first[u + 1] - x.first[u]);
+    }
+    Vector<Vector<int>> out;
+    for(Vector<int>& g : group)
+        if(g.GetCount() > 1) {
+            Sort(g);
+            out.Add(pick(g));
+        }
+    return out;
+}
+
+Vector<int> GalleryCtrl::FindDuplicates(const Vector<int>& of, int max_dist)
+{
+    max_dist = clamp(max_dist, 0, 11);
+    HashIndex x;
+    x.Build(phash, phash_bits);
+    Vector<int> out, near;
+    for(int i : of) {
+        if(!HasPerceptualHash(i))
+            continue;
+        x.Query(phash[i], max_dist, near);
+        for(int u : near)
+            out.Append(x.item, x.first[u], x.first[u + 1] - x.first[u]);
+    }
+    Sort(out);
+    out.SetCount(int(std::unique(out.begin(), out.end()) - out.begin()));
+    return out;
+}
+
+void GalleryCtrl::SelectDuplicatesOfSelection(int max_dist)
+{
+    Vector<int> sel = GetSelection();
+    Vector<int> dup = FindDuplicates(sel, max_dist);
+    sel.Append(dup);
+    CommitSelection(sel);
+}
+
+} // namespace Upp
@@ -0,0 +1,122 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== facets =================================================================
+// Every ThumbStatus value and every DF_* bit has its own bit column and a live
+// count, kept current by MarkStatus() / MarkFlags(), the only writers of
+// GalleryItem::status and ::flags. Counts are O(1); combinations such as
+// "Error AND NOT TagMissing" are word-wise operations on copies of the
+// columns, and their result can be selected or used as the filter directly.
+
+void GalleryCtrl::SyncFacets()
+{
+    const int n = items.GetCount();
+    const int m = status_bits[0].GetCount();
+    for(PackedBits& b : status_bits)
+        b.SetCount(n);
+    for(PackedBits& b : flag_index)
+        b.SetCount(n);
+    if(n < m) {                                  // removed items: recount
+        for(int s = 0; s < STATUS_COUNT; ++s)
+            status_count[s] = status_bits[s].Count();
+        for(int b = 0; b < 32; ++b)
+            flag_count[b] = flag_index[b].Count();
+        return;
+    }
+    for(int i = m; i < n; ++i) {                 // new items
+        const int s = (int)items[i].status;
+        status_bits[s].Set(i, true);
+        status_count[s]++;
+        for(dword f = items[i].flags; f; f &= f - 1) {
+            const int b = LowestBit64(f);
+            flag_index[b].Set(i, true);
+            flag_count[b]++;
+        }
+        if(items[i].flags != DF_None)            // AddBatch can bring flags along
+            MarkFlagged(i, true);
+    }
+}
+
+void GalleryCtrl::MarkStatus(int index, ThumbStatus s)
+{
+    const int was = (int)items[index].status;
+    if(was == (int)s)
+        return;
+    items[index].status = s;
+    status_bits[was].Set(index, false);
+    status_bits[(int)s].Set(index, true);
+    status_count[was]--;
+    status_count[(int)s]++;
+}
+
+void GalleryCtrl::MarkFlags(int index, DataFlags f)
+{
+    const dword was = items[index].flags;
+    items[index].flags = f;
+    for(dword d = was ^ (dword)f; d; d &= d - 1) {
+        const int b = LowestBit64(d);
+        const bool on = ((dword)f >> b) & 1;
+        flag_index[b].Set(index, on);
+        flag_count[b] += on ? 1 : -1;
+    }
+    MarkFlagged(index, f != DF_None);
+}
+
+int GalleryCtrl::GetStatusCount(ThumbStatus s) const
+{
+    return status_count[(int)s];
+}
+
+int GalleryCtrl::GetFlagCount(DataFlags flag) const
+{
+    const int b = FlagBit(flag);
+    return b < 0 ? 0 : flag_count[b];
+}
+
+const PackedBits& GalleryCtrl::GetStatusBits(ThumbStatus s) const
+{
+    return status_bits[(int)s];
+}
+
+PackedBits GalleryCtrl::GetFlagBits(DataFlags mask) const
+{
+    PackedBits r;
+    r.SetCount(items.GetCount());
+    for(dword d = mask; d; d &= d - 1)
+        r |= flag_index[LowestBit64(d)];
+    return r;
+}
+
+void GalleryCtrl::SelectBits(const PackedBits& bits)
+{
+    ScratchArena::Scope scope(scratch);
+    PackedBits& want = scratch.Bits(items.GetCount());
+    want.Assign(bits);
+    want.SetCount(items.GetCount());
+    CommitSelection(want);
+}
+
+void GalleryCtrl::FilterBits(const PackedBits& keep)
+{
+    PackedBits out(keep, 1);
+    out.SetCount(items.GetCount());
+    ApplyFiltered(out.Invert());
+}
+
+// Sets filtered_out to 'out' for every item, touching only the changed bits
+void GalleryCtrl::ApplyFiltered(const PackedBits& out)
+{
+    const uint64* was = filt_bits.Words();
+    const uint64* now = out.Words();
+    for(int wi = 0; wi < min(out.WordCount(), filt_bits.WordCount()); ++wi) {
+        const uint64 nw = now[wi];
+        for(uint64 d = was[wi] ^ nw; d; d &= d - 1) {
+            const int b = LowestBit64(d);
+            MarkFiltered(wi * 64 + b, (nw >> b) & 1);
+        }
+    }
+    Refresh();
+}
+
+} // namespace Upp
@@ -0,0 +1,272 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== metadata fields ========================================================
+// One column per field, indexed like `items`. Only the vector matching the
+// field type is populated, so a 1M-item Int column costs 8 MB, not a Value.
+
+void GalleryCtrl::MetaField::SetCount(int n)
+{
+    switch(type) {
+    case FieldType::Text:  text.SetCount(n); break;
+    case FieldType::Int:   num.SetCount(n, 0); break;
+    case FieldType::Real:  real.SetCount(n, 0.0); break;
+    case FieldType::Range: num.SetCount(n, 0); num2.SetCount(n, 0); break;
+    }
+}
+
+void GalleryCtrl::SyncFields()
+{
+    for(MetaField& f : fields)
+        f.SetCount(items.GetCount());
+    avg_color.SetCount(items.GetCount(), RGBAZero());
+    preview_hash.SetCount(items.GetCount());
+    name_key.SetCount(items.GetCount());
+    phash.SetCount(items.GetCount(), 0);
+    phash_bits.SetCount(items.GetCount());
+    color_hist.SetCount(items.GetCount() * HIST_BINS, 0);
+    sel_bits.SetCount(items.GetCount());
+    filt_bits.SetCount(items.GetCount());
+    flag_bits.SetCount(items.GetCount());
+    name_index_dirty = true;
+    SyncFacets();
+}
+
+int GalleryCtrl::AddField(const String& id, FieldType type)
+{
+    int q = FindField(id);
+    if(q >= 0)
+        return q;
+    MetaField& f = fields.Add();
+    f.id   = id;
+    f.type = type;
+    f.SetCount(items.GetCount());
+    SyncLabelLayout();                     // layouts may already reference the id
+    Refresh();
+    return fields.GetCount() - 1;
+}
+
+int GalleryCtrl::FindField(const String& id) const
+{
+    for(int i = 0; i < fields.GetCount(); ++i)
+        if(fields[i].id == id)
+            return i;
+    return -1;
+}
+
+void GalleryCtrl::SetField(int index, int field, const String& v)
+{
+    if(!TryItem(index) || field < 0 || field >= fields.GetCount()) return;
+    MetaField& f = fields[field];
+    switch(f.type) {
+    case FieldType::Text:  f.text[index] = v; break;
+    case FieldType::Int:   f.num[index] = Nvl(ScanInt64(v), (int64)0); break;
+    case FieldType::Real:  f.real[index] = Nvl(ScanDouble(v), 0.0); break;
+    case FieldType::Range: {
+        const int q = v.Find('-', 1);
+        f.num[index]  = Nvl(ScanInt64(q < 0 ? v : v.Left(q)), (int64)0);
+        f.num2[index] = q < 0 ? f.num[index] : Nvl(ScanInt64(v.Mid(q + 1)), (int64)0);
+        break;
+    }
+    }
+    Refresh();
+}
+
+void GalleryCtrl::SetField(int index, int field, int64 v)
+{
+    if(!TryItem(index) || field < 0 || field >= fields.GetCount()) return;
+    MetaField& f = fields[field];
+    switch(f.type) {
+    case FieldType::Text:  f.text[index] = AsString(v); break;
+    case FieldType::Int:   f.num[index] = v; break;
+    case FieldType::Real:  f.real[index] = (double)v; break;
+    case FieldType::Range: f.num[index] = f.num2[index] = v; break;
+    }
+    Refresh();
+}
+
+void GalleryCtrl::SetField(int index, int field, double v)
+{
+    if(!TryItem(index) || field < 0 || field >= fields.GetCount()) return;
+    MetaField& f = fields[field];
+    if(f.type == FieldType::Real) {
+        f.real[index] = v;
+        Refresh();
+    }
+    else
+        SetField(index, field, (int64)v);
+}
+
+void GalleryCtrl::SetFieldRange(int index, int field, int64 from, int64 to)
+{
+    if(!TryItem(index) || field < 0 || field >= fields.GetCount()) return;
+    MetaField& f = fields[field];
+    if(f.type != FieldType::Range) return;
+    f.num[index]  = from;
+    f.num2[index] = to;
+    Refresh();
+}
+
+String GalleryCtrl::GetFieldText(int index, int field) const
+{
+    if(!TryItem(index) || field < 0 || field >= fields.GetCount()) return String();
+    const MetaField& f = fields[field];
+    switch(f.type) {
+    case FieldType::Text:  return f.text[index];
+    case FieldType::Int:   return AsString(f.num[index]);
+    case FieldType::Real:  return FormatDouble(f.real[index], 3);
+    case FieldType::Range: return f.num[index] == f.num2[index] ? AsString(f.num[index])
+                                  : AsString(f.num[index]) + "-" + AsString(f.num2[index]);
+    }
+    return String();
+}
+
+// Runtime template -> same CT::Table format as the compiled presets (up to 4
+// lines of up to 3 fields under the image). Built once, painted like a preset.
+// Field ids are interned for the life of the process, so a table stays valid
+// when copied to another control (GetLabelLayout / SetLabelLayout) and after
+// this one is re-templated or destroyed.
+static const char* s_intern_field(const String& id)
+{
+    static ArrayIndex<String> ids;          // Array storage: ids never move, never removed
+    int q = ids.Find(id);
+    if(q < 0) {
+        q = ids.GetCount();
+        ids.Add(id);
+    }
+    return ~ids[q];
+}
+
+void GalleryCtrl::SetLabelTemplate(const String& spec)
+{
+    AssignLabelTemplate(spec);
+    SyncLabelLayout();
+    Reflow();
+    PrewarmGlyphs();
+    Refresh();
+}
+
+void GalleryCtrl::AssignLabelTemplate(const String& spec)
+{
+    enum { MAX_LINES = 4 };
+    String s = spec;
+    s.Replace("\n", ";");
+    Vector<String> lines = Split(s, ';');
+
+    Vector<String> ids;
+    Vector<int>    per_line;
+    for(int i = 0; i < lines.GetCount() && per_line.GetCount() < MAX_LINES; ++i) {
+        Vector<String> f = Split(lines[i], ',');
+        int n = 0;
+        for(int k = 0; k < f.GetCount() && n < 3; ++k) {
+            String id = TrimBoth(f[k]);
+            if(id.IsEmpty()) continue;
+            ids.Add(id);
+            n++;
+        }
+        if(n) per_line.Add(n);
+    }
+
+    CT::Layout<0, 0, MAX_LINES> l;
+    int k = 0;
+    for(int ln = 0; ln < MAX_LINES; ++ln) {
+        CT::Line& line = l.after[ln];
+        if(ln >= per_line.GetCount()) {
+            line.min_tile = INT_MAX;            // unused line: never shown
+            continue;
+        }
+        line.div = (CT::LineDiv)per_line[ln];
+        for(int j = 0; j < per_line[ln]; ++j) {
+            CT::Segment& sg = line.seg[j];
+            sg.type   = CT::SegmentType::Text;
+            sg.field  = s_intern_field(ids[k++]);
+            sg.weight = 1;
+            sg.elide  = true;
+            sg.align  = j == 0 ? -1 : j == per_line[ln] - 1 ? 1 : 0;
+        }
+    }
+    label_layout = CT::Compile(l);
+    label_preset.Clear();
+    label_template_spec = spec;
+}
+
+// ---- text measurement cache -------------------------------------------------
+// Keyed by (field, value, zoom step, box width); the entry stores the value
+// again so hash collisions are detected instead of drawing the wrong text.
+const GalleryCtrl::TextFit& GalleryCtrl::FitText(int field, int index, const GalleryItem& it, const CT::Box& bx)
+{
+    static const char* status_text[] = { "Auto", "Placeholder", "Missing", "Ok", "Error" };
+
+    const String* sv = nullptr;     // string-valued fields
+    int64 a = 0, b = 0;             // numeric-valued fields
+    const MetaField* f = field >= 0 && field < fields.GetCount() ? &fields[field] : nullptr;
+
+    switch(field) {
+    case FIELD_NAME:   sv = &it.name; break;
+    case FIELD_INDEX:  a = index + 1; break;
+    case FIELD_STATUS: a = (int)it.status; break;
+    default:
+        if(!f) {
+            static TextFit none;
+            return none;
+        }
+        switch(f->type) {
+        case FieldType::Text:  sv = &f->text[index]; break;
+        case FieldType::Int:   a = f->num[index]; break;
+        case FieldType::Real:  memcpy(&a, &f->real[index], sizeof(a)); break;
+        case FieldType::Range: a = f->num[index]; b = f->num2[index]; break;
+        }
+    }
+
+    uint64 h = sv ? (uint64)GetHashValue(*sv) : (uint64)a * 0x9E3779B97F4A7C15ull ^ (uint64)b;
+    h = h * 0x100000001B3ull ^ ((uint64)(field & 0xffff) << 32 | (uint64)zoom_i << 16 | (uint16)bx.cx);
+
+    int q = text_fit.Find(h);
+    if(q >= 0) {
+        const TextFit& c = text_fit[q];
+        if(sv ? c.text == *sv : (c.a == a && c.b == b))
+            return c;
+    }
+    else {
+        if(text_fit.GetCount() > 50000)
+            text_fit.Clear();
+        q = text_fit.GetCount();
+        text_fit.Add(h);
+    }
+
+    TextFit& c = text_fit[q];
+    c.a = a;
+    c.b = b;
+    c.text = sv ? *sv : String();
+    c.clip = false;
+
+    String txt = sv ? *sv
+               : field == FIELD_STATUS ? String(status_text[clamp((int)a, 0, 4)])
+               : field == FIELD_INDEX  ? AsString(a)
+               : GetFieldText(index, field);
+
+    const Font fnt = StdFont();
+    c.width = GetTextSize(txt, fnt).cx;
+    c.shown = txt;
+    if(c.width > bx.cx) {
+        if(bx.elide) {
+            // longest prefix that fits together with the ellipsis
+            const WString w = txt.ToWString();
+            const int ew = GetTextSize("...", fnt).cx;
+            int lo = 0, hi = w.GetCount();
+            while(lo < hi) {
+                const int m = (lo + hi + 1) / 2;
+                if(GetTextSize(w.Left(m), fnt).cx + ew <= bx.cx) lo = m;
+                else                                               hi = m - 1;
+            }
+            c.shown = w.Left(lo).ToString() + "...";
+            c.width = GetTextSize(c.shown, fnt).cx;
+        }
+        else
+            c.clip = true;
+    }
+    return c;
+}
+
+} // namespace Upp
@@ -15,11 +15,8 @@ static inline Color Mix(Color a, Color b, int t /*0..255*/)
                   (a.GetB()*u + b.GetB()*t) / 255 );
 }
 
-const int* GalleryCtrl::ZoomSteps() {
-    static const int z[] = { 32, 48, 64, 96, 128 };
-    return z;
-}
-int GalleryCtrl::ZoomStepCount() { return 5; }
+const int* GalleryCtrl::ZoomSteps() { return CT::ZOOM_STEP_PX; }
+int GalleryCtrl::ZoomStepCount()    { return CT::ZOOM_COUNT; }
 
 Rect GalleryCtrl::NormalizeRect(Rect r)
 {
@@ -37,16 +34,6 @@ static inline Color Hsv01(double h01, double s, double v) {
     return HsvColorf(h01, s, v);
 }
 
-// simple vector helpers (Vector<int> has no Find)
-static inline bool ContainsIdx(const Vector<int>& v, int x) {
-    for(int i = 0; i < v.GetCount(); ++i) if(v[i] == x) return true;
-    return false;
-}
-
-static inline void RemoveOne(Vector<int>& v, int x) {
-    for(int i = 0; i < v.GetCount(); ++i) if(v[i] == x) { v.Remove(i); return; }
-}
-
 // Simple stroke for Draw
 static void StrokeRect(Draw& w, const Rect& r, int pen, Color c)
 {
@@ -87,7 +74,8 @@ static Image ToGray(const Image& in)
 {
     if(in.IsEmpty()) return Image();
     Size sz = in.GetSize();
-    ImageBuffer ib(sz);
+    ImageBuffer ib;
+    TilePool::Take(ib, sz);             // recycled layer of this size when there is one
     const RGBA* s = in;
     for(int y = 0; y < sz.cy; ++y) {
         RGBA* t = ib[y];
@@ -104,27 +92,93 @@ static Image ToGray(const Image& in)
 // ==== ctor ===================================================================
 GalleryCtrl::GalleryCtrl()
 {
+    alive = std::make_shared<bool>(true);
     AddFrame(sb);
+    density.owner = this;
     sb.WhenScroll = [&]{
+        NoteScroll(sb.GetX() - scroll_x, sb.GetY() - scroll_y);
         scroll_x = sb.GetX();
         scroll_y = sb.GetY();
         Refresh();
     };
-    NoWantFocus();
+    NoWantFocus();                      // type-ahead is opt-in (SetTypeAhead)
+    for(int& g : flag_glyph) g = -1;
+    flag_glyph[0] = flag_glyph[1] = flag_glyph[2] = GLYPH_STATUS_WARN; // DF_* defaults
+
+    BadgeRule& fr = badge_rules.Add();  // any data flag -> one badge, top-left
+    fr.source = BadgeSource::Flag;
+    fr.key    = DF_NameMissing | DF_MetaMissing | DF_TagMissing;
+
+    SyncLabelLayout();
     Reflow();
+    PrewarmGlyphs();
+}
+
+GalleryCtrl::~GalleryCtrl()
+{
+    if(decode_owner)
+        DecodePool::Release(decode_owner);
+    *alive = false;
+    for(auto& it : items)
+        ReleaseThumb(it);
 }
 
 // ==== public API =============================================================
-int GalleryCtrl::Add(const String& name, const Image& opt_img, Color)
+int GalleryCtrl::Add(const String& name, const Image& opt_img, Color tint)
+{
+    return Add(String(name), Image(opt_img), tint);
+}
+
+// The rvalue forms take over the caller's string and pixels: no deep copy of an
+// ImageBuffer (Image(ImageBuffer&) adopts it) and no refcount traffic.
+int GalleryCtrl::Add(String&& name, Image&& img, Color tint)
 {
     GalleryItem it;
-    it.name = name;
-    it.thumb = opt_img;
     it.seed = (int)GetHashValue(name);
+    it.name = pick(name);
+    it.thumb = pick(img);
+    it.tint = tint;
     items.Add(pick(it));
+    SyncFields();
+    const int i = items.GetCount() - 1;
+    name_key.Top() = NaturalKey(items[i].name);
+    if(!items[i].thumb.IsEmpty())
+        ThumbChanged(i);
     Reflow();
     Refresh();
-    return items.GetCount() - 1;
+    return i;
+}
+
+int GalleryCtrl::Add(String&& name, ImageBuffer&& ib, Color tint)
+{
+    return Add(pick(name), Image(ib), tint);
+}
+
+// Bulk load: items are moved in, columns and indexes grow once, collation keys
+// are built across cores and the layout is reflowed once for the whole batch.
+int GalleryCtrl::AddBatch(Vector<GalleryNewItem>&& batch)
+{
+    const int first = items.GetCount();
+    items.Reserve(first + batch.GetCount());
+    for(GalleryNewItem& b : batch) {
+        GalleryItem& it = items.Add();
+        it.seed = (int)GetHashValue(b.name);
+        it.name = pick(b.name);
+        it.thumb = pick(b.thumb);
+        it.tint = b.tint;
+        it.status = b.status;
+        it.flags = b.flags;
+    }
+    batch.Clear();
+    SyncFields();                            // also indexes status / flags of the new items
+    const int n = items.GetCount();
+    CoFor(n - first, [&](int k) { name_key[first + k] = NaturalKey(items[first + k].name); });
+    for(int i = first; i < n; ++i)
+        if(!items[i].thumb.IsEmpty())
+            ThumbChanged(i);
+    Reflow();
+    Refresh();
+    return first;
 }
 
 
@@ -137,44 +191,74 @@ void GalleryCtrl::AddDummy(const String& name)
 bool GalleryCtrl::SetThumbFromFile(int index, const String& filepath)
 {
     if(index < 0 || index >= items.GetCount()) return false;
-    Image img = StreamRaster::LoadFileAny(filepath);
-    if(!img.IsEmpty()) {
-        items[index].thumb = img;
-        items[index].thumb_gray = Image();
+    const String key = ThumbCache::FileKey(filepath);
+    if(SetThumbShared(index, key))       // already decoded by this or another control
+        return true;
+    if(DecodePool::IsRunning() && DecodePool::GetWorkers()) {  // decode in a helper process, see DrainSlice
+        if(!decode_owner)
+            decode_owner = DecodePool::NewOwner([this](ThumbResult& r) { PushResult(r); });
+        DecodePool::Submit(decode_owner, index, item_gen, filepath, key);
+        MarkStatus(index, ThumbStatus::Placeholder);
         Refresh();
         return true;
     }
-    return false;
+    return DecodeThumbHere(index, filepath, key);
+}
+
+bool GalleryCtrl::DecodeThumbHere(int index, const String& path, const String& key)
+{
+    Image img = StreamRaster::LoadFileAny(path);
+    if(img.IsEmpty())
+        return false;
+    SetThumbShared(index, key, img);
+    return true;
 }
 
 
 void GalleryCtrl::SetThumbImage(int index, const Image& img)
+{
+    SetThumbImage(index, Image(img));
+}
+
+void GalleryCtrl::SetThumbImage(int index, Image&& img)
 {
     if(index < 0 || index >= items.GetCount()) return;
-    items[index].thumb = img;
-    items[index].thumb_gray = Image();
+    ReleaseThumb(items[index]);
+    DropLayers(items[index]);
+    items[index].thumb = pick(img);
+    ThumbChanged(index);
     Refresh();
 }
 
+void GalleryCtrl::SetThumbImage(int index, ImageBuffer&& ib)
+{
+    SetThumbImage(index, Image(ib));
+}
+
 
 void GalleryCtrl::ClearThumbImage(int index)
 {
     if(index < 0 || index >= items.GetCount()) return;
+    ReleaseThumb(items[index]);
+    DropLayers(items[index]);
     items[index].thumb = Image();
-    items[index].thumb_gray = Image();
+    avg_color[index] = RGBAZero();
+    phash_bits.Set(index, false);
     Refresh();
 }
 
 
 void GalleryCtrl::SetThumbStatus(int index, ThumbStatus s)
 {
-    if(auto* it = TryItem(index)) { it->status = s; Refresh(); }
+    if(TryItem(index)) { MarkStatus(index, s); Refresh(); }
 }
 
 
 void GalleryCtrl::SetDataFlags(int index, DataFlags f)
 {
-    if(auto* it = TryItem(index)) { it->flags = f; Refresh(); }
+    if(!TryItem(index)) return;
+    MarkFlags(index, f);
+    Refresh();
 }
 
 DataFlags GalleryCtrl::GetDataFlags(int index) const
@@ -183,30 +267,101 @@ DataFlags GalleryCtrl::GetDataFlags(int index) const
     return it ? it->flags : DF_None;
 }
 
+// Index of the single bit in a DF_* value, -1 if none/several
+int GalleryCtrl::FlagBit(DataFlags f)
+{
+    const unsigned v = (unsigned)f;
+    if(v == 0 || (v & (v - 1))) return -1;
+    int b = 0;
+    while(!(v & (1u << b))) ++b;
+    return b;
+}
+
+void GalleryCtrl::SetStatusGlyph(ThumbStatus s, int glyph)
+{
+    status_glyph[(int)s] = glyph < 0 ? -1 : glyph;
+    PrewarmGlyphs();
+    Refresh();
+}
+
+int GalleryCtrl::GetStatusGlyph(ThumbStatus s) const
+{
+    return status_glyph[(int)s];
+}
+
+void GalleryCtrl::SetFlagGlyph(DataFlags flag, int glyph)
+{
+    const int b = FlagBit(flag);
+    if(b < 0) return;
+    flag_glyph[b] = glyph < 0 ? -1 : glyph;
+    PrewarmGlyphs();
+    Refresh();
+}
+
+int GalleryCtrl::GetFlagGlyph(DataFlags flag) const
+{
+    const int b = FlagBit(flag);
+    return b < 0 ? -1 : flag_glyph[b];
+}
+
+// Rasterize every mapped glyph at the sizes Paint() will ask for, so painting
+// is a pure cache lookup (runtime documents are never rasterized mid-frame).
+// Badge atlas is needed by the next paint; the rest is rasterized in idle
+// slices (Glyph() still renders on demand if a tile gets there first).
+void GalleryCtrl::PrewarmGlyphs()
+{
+    const int tile = ZoomSteps()[zoom_i];
+    glyph_todo.Clear();
+    if(lod[zoom_i] & LOD_GLYPHS)
+        for(int g : status_glyph)
+            if(g >= 0) glyph_todo.Add(Point(g, tile));
+    const CT::Step& st = label_layout.step[zoom_i];
+    for(int b = 0; b < (lod[zoom_i] & LOD_LABELS ? st.count : 0); ++b)
+        if(st.box[b].type == CT::SegmentType::Icon) {
+            const int sz = max(8, st.box[b].cy - 4);
+            for(int g : { (int)GLYPH_STATUS_OK, (int)GLYPH_STATUS_WARN, (int)GLYPH_STATUS_ERR })
+                glyph_todo.Add(Point(g, sz));
+            for(int g : flag_glyph)
+                if(g >= 0) glyph_todo.Add(Point(g, sz));
+        }
+    if(glyph_todo.GetCount())
+        Schedule(TASK_GLYPHS);
+    BuildBadgeAtlas();
+}
+
 Vector<int> GalleryCtrl::GetSelection() const
 {
     Vector<int> v;
-    for(int i = 0; i < items.GetCount(); ++i)
-        if(items[i].selected)
-            v.Add(i);
+    GetSelection(v);
     return v;
 }
 
+void GalleryCtrl::GetSelection(Vector<int>& out) const
+{
+    out.SetCount(0);
+    for(int i = sel_bits.Next(0); i >= 0; i = sel_bits.Next(i + 1))
+        out.Add(i);
+}
+
 void GalleryCtrl::ClearSelection()
 {
-    for(auto& it : items) it.selected = false;
+    for(int i = sel_bits.Next(0); i >= 0; i = sel_bits.Next(i + 1))
+        MarkSelected(i, false);
     WhenSelection();
     Refresh();
 }
 
 void GalleryCtrl::SetFiltered(int index, bool filtered_out)
 {
-    if(auto* it = TryItem(index)) { it->filtered_out = filtered_out; Refresh(); }
+    if(!TryItem(index)) return;
+    MarkFiltered(index, filtered_out);
+    Refresh();
 }
 
 void GalleryCtrl::ClearFilterFlags()
 {
-    for(auto& it : items) it.filtered_out = false;
+    for(int i = filt_bits.Next(0); i >= 0; i = filt_bits.Next(i + 1))
+        MarkFiltered(i, false);
     Refresh();
 }
 
@@ -215,8 +370,10 @@ void GalleryCtrl::SetZoomIndex(int zi)
     zi = ClampInt(zi, 0, ZoomStepCount() - 1);
     if(zoom_i == zi) return;
     zoom_i = zi;
-    for(auto& it : items) it.thumb_gray = Image();
+    DropLayers();
+    SyncLabelLayout();
     Reflow();
+    PrewarmGlyphs();
     Refresh();
     WhenZoom(zoom_i);
 }
@@ -241,6 +398,20 @@ void GalleryCtrl::SetLabelBackdropAlpha(int a)
     Refresh();
 }
 
+void GalleryCtrl::SetLod(int zoom_step, dword layers)
+{
+    if(zoom_step < 0 || zoom_step >= ZoomStepCount() || lod[zoom_step] == layers) return;
+    lod[zoom_step] = layers;
+    SyncLabelLayout();                   // labels off also drops the band space
+    Reflow();
+    Refresh();
+}
+
+dword GalleryCtrl::GetLod(int zoom_step) const
+{
+    return zoom_step >= 0 && zoom_step < ZoomStepCount() ? lod[zoom_step] : LOD_ALL;
+}
+
 void GalleryCtrl::SetScrollMode(ScrollMode m)
 {
     if(scroll_mode == m) return;
@@ -260,7 +431,18 @@ void GalleryCtrl::SetTilePadding(int px)
 
 void GalleryCtrl::Clear()
 {
+    for(auto& it : items)
+        ReleaseThumb(it);
     items.Clear();
+    if(decode_owner)
+        DecodePool::Cancel(decode_owner);
+    item_gen++;
+    gen_remap.Clear();
+    SyncFields();
+    avg_todo.Clear();
+    preview_cache.Clear();
+    layer_ring.Clear();
+    density_cols = -1;                           // buckets rebuilt on next paint
     hover_index = anchor_index = caret_index = -1;
     scroll_x = scroll_y = 0;
     Reflow();
@@ -276,15 +458,15 @@ void GalleryCtrl::Layout()
 void GalleryCtrl::Reflow()
 {
     Size sz = GetSize();
-    const int tile = ZoomSteps()[zoom_i];
-    const int tw = tile;
-    const int th = tile + label_h;
+    const int tw  = CellW();
+    const int th  = CellH();
+    const int gap = Gap();
 
-    cols = max(1, (sz.cx + pad) / (tw + pad));
+    cols = max(1, (sz.cx + gap) / (tw + gap));
     rows = items.GetCount() ? ( (items.GetCount() + cols - 1) / cols ) : 0;
 
-    content_w = cols * (tw + pad) + pad;
-    content_h = rows * (th + pad) + pad;
+    content_w = cols * (tw + gap) + gap;
+    content_h = rows * (th + gap) + gap;
 
     scroll_x = ClampInt(scroll_x, 0, max(0, content_w - sz.cx));
     scroll_y = ClampInt(scroll_y, 0, max(0, content_h - sz.cy));
@@ -311,82 +493,137 @@ void GalleryCtrl::Reflow()
     }
 
     sb.Set(Point(scroll_x, scroll_y), page, total);
+    if(density_on)
+        density.Refresh();
 }
 
 Rect GalleryCtrl::TileRect(int index) const
 {
     if(index < 0 || index >= items.GetCount()) return Rect(0,0,0,0);
-    const int tile = ZoomSteps()[zoom_i];
-    const int tw = tile;
-    const int th = tile + label_h;
+    const int tw  = CellW();
+    const int th  = CellH();
+    const int gap = Gap();
 
     int r = index / cols;
     int c = index % cols;
 
-    int x = pad + c * (tw + pad);
-    int y = pad + r * (th + pad);
+    int x = gap + c * (tw + gap);
+    int y = gap + r * (th + gap);
     return RectC(x, y, tw, th);
 }
 
 Rect GalleryCtrl::ImageRect(const Rect& tile) const
 {
     Rect r = tile;
-    r.bottom -= label_h;
+    if(overview) return r;              // overview cells have no label bands
+    r.top    += band_before;
+    r.bottom -= band_after;
     return r;
 }
 
-int GalleryCtrl::IndexFromPoint(Point content_pt) const
+Color GalleryCtrl::PlaceholderTint(const GalleryItem& it) const
+{
+    return IsNull(it.tint) ? Hsv01((GetHashValue(it.name) % 360) / 360.0, 0.25, 0.90) : it.tint;
+}
+
+Size GalleryCtrl::ThumbDrawSize(Size isz, const Rect& ri) const
 {
-    for(int i = 0; i < items.GetCount(); ++i) {
-        Rect tr = TileRect(i);
-        if(tr.Contains(content_pt))
-            return i;
+    switch(aspect) {
+    case AspectPolicy::Fit:  return DrawSize<AspectPolicy::Fit>(isz, ri.GetSize());
+    case AspectPolicy::Fill: return DrawSize<AspectPolicy::Fill>(isz, ri.GetSize());
+    default:                 return DrawSize<AspectPolicy::Stretch>(isz, ri.GetSize());
     }
-    return -1;
+}
+
+// Grid arithmetic, as TileRect: the one candidate cell is checked, so hover
+// stays O(1) even over a million overview cells.
+int GalleryCtrl::IndexFromPoint(Point content_pt) const
+{
+    const int gap = Gap();
+    if(cols <= 0 || content_pt.x < gap || content_pt.y < gap)
+        return -1;
+    const int c = (content_pt.x - gap) / (CellW() + gap);
+    const int r = (content_pt.y - gap) / (CellH() + gap);
+    const int i = r * cols + c;
+    if(c >= cols || i >= items.GetCount() || !TileRect(i).Contains(content_pt))
+        return -1;                               // past the last column / item, or in a gap
+    return i;
 }
 
 // ==== selection helpers ======================================================
+// Temporaries come from 'scratch' (ScratchArena.h): a marquee drag reuses the
+// same few slots for every mouse event instead of allocating per move.
 void GalleryCtrl::CommitSelection(const Vector<int>& indices)
 {
-    // build sorted copy of indices (manual copy to avoid deleted copy-ctor pitfalls)
-    Vector<int> in;
-    in.Reserve(indices.GetCount());
-    for(int v : indices) in.Add(v);
-    Sort(in);
+    ScratchArena::Scope scope(scratch);
+    PackedBits& want = scratch.Bits(items.GetCount());
+    for(int v : indices)
+        if(v >= 0 && v < items.GetCount())
+            want.Set(v, true);
+    CommitSelection(want);
+}
 
-    // pre-veto (WhenSelecting Gate)
-    if(WhenSelecting && !WhenSelecting(in))
-        return;
+// Selection := want; the veto gate sees it as a sorted list, and only items
+// whose state changes are touched.
+void GalleryCtrl::CommitSelection(const PackedBits& want)
+{
+    ScratchArena::Scope scope(scratch);
+    if(WhenSelecting) {
+        Vector<int>& in = scratch.Ints();
+        for(int i = want.Next(0); i >= 0; i = want.Next(i + 1))
+            in.Add(i);
+        if(!WhenSelecting(in))
+            return;
+    }
 
-    for(int i = 0; i < items.GetCount(); ++i)
-        items[i].selected = false;
-    for(int v : in)
-        if(v >= 0 && v < items.GetCount())
-            items[v].selected = true;
+    const uint64* was = sel_bits.Words();
+    const uint64* now = want.Words();
+    for(int wi = 0; wi < min(want.WordCount(), sel_bits.WordCount()); ++wi) {
+        const uint64 nw = now[wi];
+        for(uint64 d = was[wi] ^ nw; d; d &= d - 1) {
+            const int b = LowestBit64(d);
+            MarkSelected(wi * 64 + b, (nw >> b) & 1);
+        }
+    }
 
     WhenSelection();
     Refresh();
 }
 
-Vector<int> GalleryCtrl::IndicesInRect(const Rect& rc) const
+// Only the rows and columns the rect can reach are tested; out must be sized.
+void GalleryCtrl::IndicesInRect(const Rect& rc, PackedBits& out) const
 {
-    Vector<int> out;
-    for(int i = 0; i < items.GetCount(); ++i)
-        if(TileRect(i).Intersects(rc))
-            out.Add(i);
-    return out;
+    if(cols <= 0)
+        return;
+    const int sx = CellW() + Gap(), sy = CellH() + Gap();
+    const int r0 = max(0, rc.top / sy - 1),  r1 = min(rows - 1, rc.bottom / sy + 1);
+    const int c0 = max(0, rc.left / sx - 1), c1 = min(cols - 1, rc.right / sx + 1);
+    for(int r = r0; r <= r1; ++r)
+        for(int c = c0; c <= c1; ++c) {
+            const int i = r * cols + c;
+            if(i < items.GetCount() && TileRect(i).Intersects(rc))
+                out.Set(i, true);
+        }
 }
 
 // ==== events / interaction ===================================================
 void GalleryCtrl::MouseWheel(Point, int zdelta, dword keyflags)
 {
     if(keyflags & K_CTRL) {
-        SetZoomIndex(zoom_i + (zdelta > 0 ? +1 : -1));
+        // below the smallest zoom step: overview cells 8 -> 4 -> 2 px
+        const bool in = zdelta > 0;
+        if(overview)
+            SetOverview(in ? (overview >= 8 ? 0 : overview * 2) : max(2, overview / 2));
+        else
+        if(!in && zoom_i == 0)
+            SetOverview(8);
+        else
+            SetZoomIndex(zoom_i + (in ? +1 : -1));
         return;
     }
 
     // Simple per-wheel step
-    const int th = ZoomSteps()[zoom_i] + label_h + pad;
+    const int th = CellH() + Gap();
     const int step = max(8, th / 3);
     int dir = (zdelta > 0) ? -1 : +1;
 
@@ -405,6 +642,8 @@ void GalleryCtrl::MouseWheel(Point, int zdelta, dword keyflags)
 
 bool GalleryCtrl::Key(dword key, int)
 {
+    if(TypeAheadKey(key))
+        return true;
     // Delegate PageUp/Down, Home/End, Arrow to ScrollBars
     if(sb.Key(key)) {
         scroll_x = sb.GetX();
@@ -447,11 +686,7 @@ void GalleryCtrl::MouseMove(Point p, dword flags)
         drag_rect_win    = Rect(p, p);
 
         // Baseline
-        drag_prev_sel.Clear();
-        const auto cur = GetSelection();
-        drag_prev_sel.Reserve(cur.GetCount());
-        for(int k = 0; k < cur.GetCount(); ++k)
-            drag_prev_sel.Add(cur[k]);
+        drag_prev_sel.Assign(sel_bits);
 
         // When adopted mid-drag, any pending click is irrelevant
         pending_click = false;
@@ -531,11 +766,7 @@ void GalleryCtrl::LeftDown(Point p, dword flags)
     drag_rect_win    = Rect(p, p);
 
     // Baseline from current selection (for any marquee mode)
-    drag_prev_sel.Clear();
-    const auto cur = GetSelection();
-    drag_prev_sel.Reserve(cur.GetCount());
-    for(int k = 0; k < cur.GetCount(); ++k)
-        drag_prev_sel.Add(cur[k]);
+    drag_prev_sel.Assign(sel_bits);
 
     if(i < 0) {
         // Clicked whitespace: immediate clear only if NO modifiers (replace intent)
@@ -543,8 +774,10 @@ void GalleryCtrl::LeftDown(Point p, dword flags)
         pending_index = -1;
         pending_flags = 0;
 
-        if(!ctrl && !shift && !alt && cur.GetCount())
-            CommitSelection(Vector<int>()); // immediate feedback
+        if(!ctrl && !shift && !alt && sel_bits.Next(0) >= 0) {
+            ScratchArena::Scope scope(scratch);
+            CommitSelection(scratch.Bits(items.GetCount())); // immediate feedback
+        }
         return;
     }
 
@@ -570,9 +803,9 @@ void GalleryCtrl::LeftUp(Point, dword)
         const bool ctrl  = (pending_flags & K_CTRL)  != 0;
         const bool shift = (pending_flags & K_SHIFT) != 0;
 
-        Vector<int> next; next.Reserve(16);
-        const auto  cur = GetSelection();
-        for(int k = 0; k < cur.GetCount(); ++k) next.Add(cur[k]);
+        ScratchArena::Scope scope(scratch);
+        Vector<int>& next = scratch.Ints();
+        GetSelection(next);
 
         const int i = pending_index;
 
@@ -622,66 +855,34 @@ void GalleryCtrl::RightDown(Point p, dword)
         MenuBar::Execute(WhenBar, p);
 }
 
-// Marquee combiner
+// Marquee combiner: baseline (selection at drag start) and hits as bit columns,
+// combined a word at a time
 void GalleryCtrl::ApplyMarqueeSelection(bool add, bool sub, bool inter, bool xr)
 {
+    ScratchArena::Scope scope(scratch);
+    const int n = items.GetCount();
+
     // Convert marquee rect to CONTENT coords
     Rect selc = NormalizeRect(drag_rect_win);
     selc.Offset(scroll_x, scroll_y);
 
     // All tiles intersecting the marquee
-    Vector<int> hits = IndicesInRect(selc);
-
-    Vector<int> next;
-    next.Clear();
-
-    if(inter) {
-        // baseline ∩ hits
-        for(int i = 0; i < drag_prev_sel.GetCount(); ++i) {
-            int id = drag_prev_sel[i];
-            if(ContainsIdx(hits, id))
-                next.Add(id);
-        }
-    }
-    else if(sub) {
-        // baseline − hits
-        next.Reserve(drag_prev_sel.GetCount());
-        for(int i = 0; i < drag_prev_sel.GetCount(); ++i) {
-            int id = drag_prev_sel[i];
-            if(!ContainsIdx(hits, id))
-                next.Add(id);
-        }
-    }
-    else if(xr) {
-        // XOR/toggle: symmetric difference with hits
-        // start from baseline (manual copy, no assignment)
-        next.Reserve(drag_prev_sel.GetCount());
-        for(int i = 0; i < drag_prev_sel.GetCount(); ++i)
-            next.Add(drag_prev_sel[i]);
-
-        for(int i = 0; i < hits.GetCount(); ++i) {
-            int id = hits[i];
-            if(ContainsIdx(next, id)) RemoveOne(next, id);
-            else                      next.Add(id);
-        }
-    }
-    else if(add) {
-        // baseline ∪ hits
-        next.Reserve(drag_prev_sel.GetCount() + hits.GetCount());
-        for(int i = 0; i < drag_prev_sel.GetCount(); ++i)
-            next.Add(drag_prev_sel[i]);
-        for(int i = 0; i < hits.GetCount(); ++i) {
-            int id = hits[i];
-            if(!ContainsIdx(next, id))
-                next.Add(id);
-        }
-    }
-    else {
-        // replace = hits (manual copy)
-        next.Reserve(hits.GetCount());
-        for(int i = 0; i < hits.GetCount(); ++i)
-            next.Add(hits[i]);
-    }
+    PackedBits& hits = scratch.Bits(n);
+    IndicesInRect(selc, hits);
+
+    PackedBits& next = scratch.Bits(n);
+    next.Assign(drag_prev_sel);
+    next.SetCount(n);                            // items may have come or gone mid-drag
+    if(inter)
+        next &= hits;                            // baseline ∩ hits
+    else if(sub)
+        next.AndNot(hits);                       // baseline − hits
+    else if(xr)
+        next ^= hits;                            // XOR/toggle: symmetric difference
+    else if(add)
+        next |= hits;                            // baseline ∪ hits
+    else
+        next.Assign(hits);                       // replace = hits
 
     CommitSelection(next);
 }
@@ -697,131 +898,272 @@ void GalleryCtrl::Paint(Draw& w)
     if(items.IsEmpty())
         return;
 
+    if(overview) {
+        PaintOverview(w);
+        PaintRubberBand(w);
+        return;
+    }
+
     const int tile = ZoomSteps()[zoom_i];
     const int tw = tile;
-    const int th = tile + label_h;
+    const int th = tile + band_before + band_after;
 
     const int y0 = scroll_y;
     const int y1 = scroll_y + sz.cy;
 
+    const bool  fast = adaptive_quality && fast_scroll;   // skip labels, badges, hover
+    const dword ld   = lod[zoom_i];
+    const bool  labels_on = !fast && (ld & LOD_LABELS);
+    const bool  rings_on  = !fast && (ld & LOD_RINGS);
+    const bool  badges_on = !fast && (ld & LOD_BADGES) && zoom_i >= badge_min_zoom && !badge_rules.IsEmpty();
+    const Color back = Mix(SColorLtFace(), SColorPaper(), 255 - label_backdrop_alpha);
+
     int first_row = max(0, (y0 - pad) / (th + pad));
     int last_row  = min(rows - 1, (y1 - 1) / (th + pad));
 
-    for(int r = first_row; r <= last_row; ++r) {
-        for(int c = 0; c < cols; ++c) {
-            int i = r * cols + c;
-            if(i >= items.GetCount()) break;
-
-            Rect rt = TileRect(i);
-            rt.Offset(-scroll_x, -scroll_y);
-
-            const Rect ri = ImageRect(rt);
-            Rect lab = rt; lab.top = ri.bottom;
-
-            // Fill tile face
-            w.DrawRect(rt, SColorPaper());
-
-            const auto& it = items[i];
-
-            if(it.status == ThumbStatus::Ok && !it.thumb.IsEmpty()) {
-                const Size isz = it.thumb.GetSize();
-                Rect tr = ri;
-                Size dst = isz;
-
-                if(aspect == AspectPolicy::Fit) {
-                    int w0 = tr.GetWidth(), h0 = tr.GetHeight();
-                    double sx = (double)w0 / isz.cx, sy = (double)h0 / isz.cy;
-                    double s = min(sx, sy);
-                    dst.cx = int(isz.cx * s + 0.5);
-                    dst.cy = int(isz.cy * s + 0.5);
-                }
-                else if(aspect == AspectPolicy::Fill) {
-                    int w0 = tr.GetWidth(), h0 = tr.GetHeight();
-                    double sx = (double)w0 / isz.cx, sy = (double)h0 / isz.cy;
-                    double s = max(sx, sy);
-                    dst.cx = int(isz.cx * s + 0.5);
-                    dst.cy = int(isz.cy * s + 0.5);
-                }
-                else { // Stretch
-                    dst = tr.GetSize();
-                }
-
-                int dx = tr.left + (tr.GetWidth()  - dst.cx) / 2;
-                int dy = tr.top  + (tr.GetHeight() - dst.cy) / 2;
-
-                const Image& draw_im = (it.filtered_out)
-                    ? (it.thumb_gray.IsEmpty() ? (items[i].thumb_gray = ToGray(it.thumb)) : it.thumb_gray)
-                    : it.thumb;
-
-                w.DrawImage(dx, dy, dst.cx, dst.cy, draw_im);
-            }
-            else {
-                const int g = min(ri.GetWidth(), ri.GetHeight());
-                Rect gr = ri; gr.SetSize(Size(g, g));
-                gr.Offset((ri.GetWidth() - g)/2, (ri.GetHeight() - g)/2);
-                const Image* gimg = nullptr;
-                switch(it.status) {
-                case ThumbStatus::Placeholder: gimg = &PlaceholderGlyph(g); break;
-                case ThumbStatus::Missing:     gimg = &MissingGlyph(g);     break;
-                case ThumbStatus::Error:       gimg = &ErrorGlyph(g);       break;
-                case ThumbStatus::Auto:
-                default: {
-                    Color tint = Hsv01((GetHashValue(it.name) % 360) / 360.0, 0.25, 0.90);
-                    w.DrawRect(ri, Mix(SColorFace(), tint, 64));
-                    w.DrawRect(ri.Deflated(ri.Width()/6, ri.Height()/6), Mix(tint, SColorPaper(), 48));
-                    break;
-                }
-                }
-                if(gimg)
-                    w.DrawImage(gr, *gimg);
-            }
+    // Tiles are drawn as layer passes over buckets of like tiles (see PaintTiles)
+    PaintFrame f;
+    f.first  = min(first_row * cols, items.GetCount());
+    f.end    = min((last_row + 1) * cols, items.GetCount());
+    f.box    = ImageRect(RectC(0, 0, tw, th)).GetSize();
+    f.ld     = ld;
+    f.fast   = fast;
+    f.labels = labels_on;
+    f.rings  = rings_on;
+    f.badges = badges_on;
+    f.back   = back;
+    PaintTiles(w, f);
+
+    // Badge layer: one batched pass from the atlas
+    if(badges_on)
+        PaintBadges(w);
+
+    paint_first_row = first_row;
+    paint_last_row  = last_row;
+    if(labels_on)
+        QueueTextRows(first_row, last_row);
+
+    PaintRubberBand(w);
+}
 
-            // Flag dot (orange)
-            if(it.flags != DF_None) {
-                Rect d = rt.Deflated(4);
-                Rect dot = RectC(d.left, d.top, 6, 6);
-                w.DrawRect(dot, Color(245, 158, 11));
-                StrokeRect(w, dot.Inflated(1), 1, SColorPaper());
-            }
+// ==== tile paint passes ======================================================
+// Instead of deciding per tile and per layer what to draw, one pass sorts the
+// visible tiles into buckets by how their image is drawn, and each bucket is
+// drawn by a kernel specialized for its kind and the aspect policy, both fixed
+// at compile time. Decorations follow as passes over just the tiles that have
+// them (selection and filter rings walk the bit columns). The kernel set is
+// picked once per frame. Tiles do not overlap, so layer-by-layer across tiles
+// gives the same picture as the old tile-by-tile order.
 
-            // Label bar (simulated translucency via Mix)
-            if(label_h > 0) {
-                Color back = Mix(SColorLtFace(), SColorPaper(), 255 - label_backdrop_alpha);
-                w.DrawRect(lab, back);
-                String txt = it.name;
-                w.DrawText(lab.left + 4, lab.top + (lab.GetHeight() - StdFont().GetCy()) / 2,
-                           txt, StdFont(), SColorText());
+void GalleryCtrl::PaintTiles(Draw& w, const PaintFrame& f)
+{
+    ScratchArena::Scope scope(scratch);
+    Vector<int>* bucket[TK__COUNT];
+    for(Vector<int>*& b : bucket)
+        b = &scratch.Ints();
+    switch(aspect) {
+    case AspectPolicy::Fit:  PaintTiles<AspectPolicy::Fit>(w, f, bucket); break;
+    case AspectPolicy::Fill: PaintTiles<AspectPolicy::Fill>(w, f, bucket); break;
+    default:                 PaintTiles<AspectPolicy::Stretch>(w, f, bucket); break;
+    }
+}
+
+template <AspectPolicy A>
+void GalleryCtrl::ClassifyTiles(const PaintFrame& f, Vector<int>* bucket[TK__COUNT])
+{
+    bool refine = false, gray = false;
+    for(int i = f.first; i < f.end; ++i) {
+        const GalleryItem& it = items[i];
+        int k;
+        if(it.status == ThumbStatus::Ok && !it.thumb.IsEmpty()) {
+            const bool mip_ok = it.thumb_mip.GetSize() == DrawSize<A>(it.thumb.GetSize(), f.box);
+            if(f.fast)          // cheapest cached level only; refined after the scroll settles
+                k = it.thumb_mip.IsEmpty() ? TK_FAST_TINT : mip_ok ? TK_FAST_MIP : TK_FAST_SCALED;
+            else
+            if(mip_ok && !it.filtered_out)
+                k = TK_MIP;
+            else {
+                refine |= !mip_ok;
+                // gray copy is made in an idle slice; until then draw muted color
+                const bool gray_pending = it.filtered_out && it.thumb_gray.IsEmpty();
+                gray |= gray_pending;
+                k = gray_pending ? TK_GRAY_PENDING : TK_SCALED;
             }
+        }
+        else
+        if(it.status <= ThumbStatus::Placeholder && !preview_hash[i].IsEmpty())
+            k = it.filtered_out ? TK_PREVIEW_FILTERED : TK_PREVIEW;
+        else
+            k = f.ld & LOD_GLYPHS && status_glyph[(int)it.status] >= 0 ? TK_GLYPH : TK_TINT;
+        bucket[k]->Add(i);
+    }
+    if(refine && adaptive_quality)
+        Schedule(TASK_REFINE);
+    if(gray)
+        Schedule(TASK_GRAY);
+}
 
-            // Hover ring
-            if(hover_enabled && hover_index == i && !it.selected) {
-                Color ring = Mix(SColorHighlight(), SColorFace(), 160);
-                StrokeRect(w, rt, 1, ring);
+template <int KIND, AspectPolicy A>
+void GalleryCtrl::PaintBucket(Draw& w, const PaintFrame& f, const Vector<int>& tiles)
+{
+    const Color face = SColorFace(), paper = SColorPaper();
+    for(int i : tiles) {
+        const GalleryItem& it = items[i];
+        const Rect ri = ImageRect(TileRect(i).Offseted(-scroll_x, -scroll_y));
+        if(KIND <= TK_FAST_SCALED) {
+            const Size dst = DrawSize<A>(it.thumb.GetSize(), f.box);
+            const int  dx  = ri.left + (ri.GetWidth()  - dst.cx) / 2;
+            const int  dy  = ri.top  + (ri.GetHeight() - dst.cy) / 2;
+            if(KIND == TK_MIP || KIND == TK_FAST_MIP)
+                w.DrawImage(dx, dy, it.thumb_mip);
+            if(KIND == TK_FAST_SCALED)
+                w.DrawImage(dx, dy, dst.cx, dst.cy, it.thumb_mip);
+            if(KIND == TK_SCALED)
+                w.DrawImage(dx, dy, dst.cx, dst.cy, it.filtered_out ? it.thumb_gray : it.thumb);
+            if(KIND == TK_GRAY_PENDING) {
+                w.DrawImage(dx, dy, dst.cx, dst.cy, it.thumb);
+                PaintOverlay(w, RectC(dx, dy, dst.cx, dst.cy), paper, 160);
             }
+        }
+        if(KIND == TK_FAST_TINT)
+            w.DrawRect(ri, Mix(face, PlaceholderTint(it), 64));
+        if(KIND == TK_PREVIEW || KIND == TK_PREVIEW_FILTERED) {
+            // blurred stand-in; the 32 px decode is smooth enough to stretch
+            w.DrawImage(ri, PreviewImage(i));
+            if(KIND == TK_PREVIEW_FILTERED)
+                PaintOverlay(w, ri, paper, 160);
+        }
+        if(KIND == TK_GLYPH) {
+            const int g = min(ri.GetWidth(), ri.GetHeight());
+            Rect gr = ri; gr.SetSize(Size(g, g));
+            gr.Offset((ri.GetWidth() - g)/2, (ri.GetHeight() - g)/2);
+            w.DrawImage(gr, Glyph(status_glyph[(int)it.status], g));
+        }
+        if(KIND == TK_TINT) {
+            const Color tint = PlaceholderTint(it);
+            w.DrawRect(ri, Mix(face, tint, 64));
+            w.DrawRect(ri.Deflated(ri.Width()/6, ri.Height()/6), Mix(tint, paper, 48));
+        }
+    }
+}
 
-			// Selection tint (~10%) + ring
-			if(it.selected) {
-			    w.DrawImage(rt.left, rt.top, MakeAlphaOverlay(rt.GetSize(), SColorHighlight(), 26));
-			    if(show_sel_ring)
-			        StrokeRect(w, rt, 2, SColorHighlight());
-			}
+// Selection tint (~10%) + ring
+template <bool TINT, bool RING>
+void GalleryCtrl::PaintSelected(Draw& w, const PaintFrame& f)
+{
+    const Color hl = SColorHighlight();
+    for(int i = sel_bits.Next(f.first); i >= 0 && i < f.end; i = sel_bits.Next(i + 1)) {
+        const Rect rt = TileRect(i).Offseted(-scroll_x, -scroll_y);
+        if(TINT)
+            PaintOverlay(w, rt, hl, 26);
+        if(RING)
+            StrokeRect(w, rt, 2, hl);
+    }
+}
 
-            // Filter border (subtle)
-            if(show_filter_ring && it.filtered_out) {
-                StrokeRect(w, rt, 1, Mix(SColorPaper(), SColorShadow(), 200));
-            }
+template <AspectPolicy A>
+void GalleryCtrl::PaintTiles(Draw& w, const PaintFrame& f, Vector<int>* bucket[TK__COUNT])
+{
+    ClassifyTiles<A>(f, bucket);
+
+    // Fill tile faces
+    const Color paper = SColorPaper();
+    for(int i = f.first; i < f.end; ++i)
+        w.DrawRect(TileRect(i).Offseted(-scroll_x, -scroll_y), paper);
+
+    PaintBucket<TK_MIP, A>(w, f, *bucket[TK_MIP]);
+    PaintBucket<TK_SCALED, A>(w, f, *bucket[TK_SCALED]);
+    PaintBucket<TK_GRAY_PENDING, A>(w, f, *bucket[TK_GRAY_PENDING]);
+    PaintBucket<TK_FAST_MIP, A>(w, f, *bucket[TK_FAST_MIP]);
+    PaintBucket<TK_FAST_SCALED, A>(w, f, *bucket[TK_FAST_SCALED]);
+    PaintBucket<TK_FAST_TINT, A>(w, f, *bucket[TK_FAST_TINT]);
+    PaintBucket<TK_PREVIEW, A>(w, f, *bucket[TK_PREVIEW]);
+    PaintBucket<TK_PREVIEW_FILTERED, A>(w, f, *bucket[TK_PREVIEW_FILTERED]);
+    PaintBucket<TK_GLYPH, A>(w, f, *bucket[TK_GLYPH]);
+    PaintBucket<TK_TINT, A>(w, f, *bucket[TK_TINT]);
+
+    if(f.badges || f.labels)
+        for(int i = f.first; i < f.end; ++i) {
+            const Rect rt = TileRect(i).Offseted(-scroll_x, -scroll_y);
+            if(f.badges)
+                QueueBadges(items[i], ImageRect(rt));
+            // Labels (precompiled layout boxes; simulated translucency via Mix)
+            if(f.labels)
+                PaintLabels(w, i, items[i], rt, f.back);
         }
+
+    // Hover ring
+    if(f.rings && hover_enabled && hover_index >= f.first && hover_index < f.end && !items[hover_index].selected)
+        StrokeRect(w, TileRect(hover_index).Offseted(-scroll_x, -scroll_y), 1,
+                   Mix(SColorHighlight(), SColorFace(), 160));
+
+    const bool tint = f.ld & LOD_SEL_TINT;
+    if(tint && show_sel_ring)
+        PaintSelected<true, true>(w, f);
+    else
+    if(tint)
+        PaintSelected<true, false>(w, f);
+    else
+        PaintSelected<false, true>(w, f);        // selection never disappears
+
+    // Filter border (subtle)
+    if(f.rings && show_filter_ring) {
+        const Color c = Mix(SColorPaper(), SColorShadow(), 200);
+        for(int i = filt_bits.Next(f.first); i >= 0 && i < f.end; i = filt_bits.Next(i + 1))
+            StrokeRect(w, TileRect(i).Offseted(-scroll_x, -scroll_y), 1, c);
     }
+}
 
-	// Rubber band (outline + ~10% halo)
+// Rubber band (outline + ~10% halo)
+void GalleryCtrl::PaintRubberBand(Draw& w)
+{
 	if(dragging) {
 	    Rect r = NormalizeRect(drag_rect_win);
 	    r.Offset(-scroll_x, -scroll_y);
 	    StrokeRect(w, r, 1, SColorHighlight());
-	    w.DrawImage(r.left, r.top, MakeAlphaOverlay(r.GetSize(), SColorHighlight(), 26));
+	    PaintOverlay(w, r, SColorHighlight(), 26);
 	}
 }
 
+// Translucent fill: one cached SWATCH px square per (color, alpha), drawn in
+// pieces over r. Every tile size and the rubber band share it, so a frame
+// never builds an overlay image.
+void GalleryCtrl::PaintOverlay(Draw& w, const Rect& r, Color c, int alpha)
+{
+    enum { SWATCH = 256, MAX_SWATCHES = 16 };
+    if(r.IsEmpty())
+        return;
+    const int64 key = ((int64)c.GetRaw() << 8) | (byte)alpha;
+    int q = overlay_swatch.Find(key);
+    if(q < 0) {
+        if(overlay_swatch.GetCount() >= MAX_SWATCHES)    // skin changes
+            overlay_swatch.Clear();
+        q = overlay_swatch.GetCount();
+        overlay_swatch.Add(key, MakeAlphaOverlay(Size(SWATCH, SWATCH), c, alpha));
+    }
+    const Image& s = overlay_swatch[q];
+    for(int y = r.top; y < r.bottom; y += SWATCH)
+        for(int x = r.left; x < r.right; x += SWATCH)
+            w.DrawImage(x, y, s, RectC(0, 0, min((int)SWATCH, r.right - x), min((int)SWATCH, r.bottom - y)));
+}
+
+// Converts one visible filtered thumbnail to gray (TASK_GRAY slice).
+// Off-screen items are converted when they are painted.
+bool GalleryCtrl::GraySlice()
+{
+    const int end = min((paint_last_row + 1) * cols, items.GetCount());
+    for(int i = max(0, paint_first_row * cols); i < end; ++i) {
+        GalleryItem& it = items[i];
+        if(it.filtered_out && it.thumb_gray.IsEmpty() && it.status == ThumbStatus::Ok && !it.thumb.IsEmpty()) {
+            it.thumb_gray = ToGray(it.thumb);
+            NoteLayer(i);
+            DirtyTile(i);
+            return true;
+        }
+    }
+    return false;
+}
+
 // ==== Procedural thumbs & glyphs =============================================
 using Upp::BufferPainter;
 
@@ -971,15 +1313,24 @@ static void s_draw_mountains(BufferPainter& p, const Rect& inset,
     p.Clip();
 }
 
-const Image& GalleryCtrl::Glyph(GlyphType type, int tile)
+ArrayMap<int, Image>& GalleryCtrl::GlyphCache()
 {
-    static VectorMap<int, Image> cache; // key = (type<<16) | size
-    tile = ClampInt(tile, 16, 512);
-    int key = (int(type) << 16) | (tile & 0xFFFF);
+    static ArrayMap<int, Image> cache; // stable addresses: callers keep references
+    return cache;
+}
+
+const Image& GalleryCtrl::Glyph(int type, int tile)
+{
+    ArrayMap<int, Image>& cache = GlyphCache();
+    tile = ClampInt(tile, 8, 512);
+    int key = (type << 16) | (tile & 0xFFFF);
     int fi = cache.Find(key);
     if(fi >= 0)
         return cache[fi];
 
+    if(type >= GLYPH__COUNT && type < GetGlyphCount())
+        return cache.Add(key, RenderGlyphDoc(type, tile));
+
     ImageBuffer ib(tile, tile);
     BufferPainter p; p.Create(ib, MODE_ANTIALIASED);
 
@@ -4,6 +4,13 @@
 #include <CtrlLib/CtrlLib.h>
 #include <Painter/Painter.h>
 
+#include <memory>
+
+#include "GalleryLayout.h"
+#include "MpscQueue.h"
+#include "PackedBits.h"
+#include "ScratchArena.h"
+
 namespace Upp {
 
 //----------------------------------------------------------------------------
@@ -26,6 +33,35 @@ enum DataFlags : unsigned {
 
 enum class ScrollMode { Auto, VerticalOnly, HorizontalOnly, None };
 
+// Per-item metadata field types (stored column-wise, see AddField)
+enum class FieldType { Text, Int, Real, Range };
+
+// Badge layer: small glyphs stacked inward from the image corners.
+enum class BadgeCorner { TopLeft, TopRight, BottomLeft, BottomRight };
+enum class BadgeSource {
+    Status,  // key = ThumbStatus value; shown when item status matches
+    Flag,    // key = DF_* mask; shown once if any bit is set (glyph -1 = per-bit flag glyph)
+    Custom   // key = bit number in the item's custom badge bits
+};
+
+struct BadgeRule : Moveable<BadgeRule> {
+    BadgeSource source = BadgeSource::Flag;
+    unsigned    key    = 0;
+    int         glyph  = -1;
+    BadgeCorner corner = BadgeCorner::TopLeft;
+    int         slot   = -1;    // atlas slot (resolved when the atlas is built)
+};
+
+// Level of detail: layers painted at a zoom step (see SetLod)
+enum LodLayer : dword {
+    LOD_LABELS   = 1 << 0,  // label bands (off also removes the band space)
+    LOD_BADGES   = 1 << 1,  // badge layer
+    LOD_RINGS    = 1 << 2,  // hover + filter rings
+    LOD_GLYPHS   = 1 << 3,  // status glyphs; off = flat tint
+    LOD_SEL_TINT = 1 << 4,  // selection overlay; off = selection ring only
+    LOD_ALL      = LOD_LABELS | LOD_BADGES | LOD_RINGS | LOD_GLYPHS | LOD_SEL_TINT
+};
+
 // Small, square glyphs drawn procedurally & cached.
 enum GlyphType {
     GLYPH_PLACEHOLDER = 0,   // mountains + sun, gray
@@ -35,7 +71,7 @@ enum GlyphType {
     GLYPH_STATUS_OK,          // green dot
     GLYPH_STATUS_WARN,        // yellow dot
     GLYPH_STATUS_ERR,         // red dot
-    GLYPH__COUNT
+    GLYPH__COUNT              // runtime glyphs (RegisterGlyph) start here
 };
 
 //----------------------------------------------------------------------------
@@ -45,11 +81,147 @@ struct GalleryItem : Moveable<GalleryItem> {
     String      name;
     Image       thumb;          // color
     Image       thumb_gray;     // cached grayscale for filtered state
+    Image       thumb_mip;      // thumb prescaled to its tile draw size (adaptive quality)
     int         seed = 0;
     ThumbStatus status = ThumbStatus::Auto;
     bool        selected = false;
     bool        filtered_out = false;
     DataFlags   flags = DF_None;
+    dword       badges = 0;     // custom badge bits (BadgeSource::Custom)
+    String      thumb_key;      // ThumbCache entry held by this item (empty = private image)
+    Color       tint = Null;    // placeholder tint (Null = hue from the name)
+};
+
+// Prepared item for GalleryCtrl::AddBatch (moved in, never copied)
+struct GalleryNewItem : Moveable<GalleryNewItem> {
+    String      name;
+    Image       thumb;
+    Color       tint = Null;
+    ThumbStatus status = ThumbStatus::Auto;
+    DataFlags   flags = DF_None;
+};
+
+//----------------------------------------------------------------------------
+//  Process-wide thumbnail cache (shared by every GalleryCtrl)
+//
+//  Entries are keyed by asset identity and reference counted by the items that
+//  show them; unreferenced entries stay cached (LRU) until the global budget
+//  is exceeded. Thread safe.
+//----------------------------------------------------------------------------
+class ThumbCache {
+public:
+    static String FileKey(const String& path);            // normalized path + size + mtime
+    static Image  Acquire(const String& key);             // +1 ref; empty if not cached
+    static Image  Insert(const String& key, const Image& img); // +1 ref; returns the shared copy
+    static void   Release(const String& key);             // -1 ref (entry may be evicted later)
+    static void   Purge();                                // drop all unreferenced entries
+
+    static void   SetBudget(int64 bytes);                 // default 256 MB
+    static int64  GetBudget();
+    static int64  GetUsage();                             // bytes, referenced + cached
+    static int    GetCount();
+    static int64  GetHits();
+    static int64  GetMisses();
+};
+
+//----------------------------------------------------------------------------
+//  Process-wide pool of tile pixel buffers, one free list per exact size
+//
+//  Tile layers (gray variants, prescaled mips, decoded thumbnails) come in a
+//  handful of sizes: the zoom steps times a few aspect ratios. Released
+//  buffers wait in their size class and back the next image of that size, so
+//  scrolling reuses the same blocks instead of allocating and freeing one per
+//  tile. Free buffers beyond the budget are released, least recently used
+//  size class first. Thread safe.
+//----------------------------------------------------------------------------
+struct TilePoolStats {
+    int64 takes    = 0;             // buffers requested
+    int64 reused   = 0;             // ... served from a free list
+    int64 recycled = 0;             // buffers given back
+    int64 dropped  = 0;             // ... freed instead (over budget, pooling off)
+    int64 bytes    = 0;             // pixels waiting in free lists
+    int64 peak     = 0;             // high-water mark of 'bytes'
+    int   classes  = 0;             // sizes with free buffers
+};
+
+class TilePool {
+public:
+    static void  Take(ImageBuffer& ib, Size sz);          // recycled block of this size, else new
+    static void  Recycle(Image& img);                     // give back pixels the caller owns; clears img
+    static void  Purge();                                 // free all waiting buffers
+
+    static void  SetBudget(int64 bytes);                  // default 32 MB, 0 = no pooling
+    static int64 GetBudget();
+    static TilePoolStats GetStats();
+    static void  ResetStats();                            // counters only
+};
+
+//----------------------------------------------------------------------------
+//  Completed thumbnail work, handed to the GUI thread through a lock-free queue
+//----------------------------------------------------------------------------
+struct ThumbResult : Moveable<ThumbResult> {
+    int         index = -1;
+    int         gen   = -1;         // item generation at submission; -1 = unchecked
+    Image       img;
+    ThumbStatus status = ThumbStatus::Ok;
+    String      key;                // ThumbCache key (optional)
+    String      path;               // source file (decode jobs)
+    bool        cancelled   = false; // decode pool stopped before the job ran
+    bool        unavailable = false; // ... or had no worker up: decode in-process
+};
+
+//----------------------------------------------------------------------------
+//  Out-of-process decode pool (optional)
+//
+//  Decoding runs in helper processes (this executable, restarted with a
+//  worker switch); pixels come back through a shared-memory slot ring per
+//  worker. A crashing or hanging decoder only costs its own item, which is
+//  reported as failed, and the worker is restarted. Workers that cannot start
+//  are retried with a growing delay; while none is up, SetThumbFromFile()
+//  decodes in-process. Call WorkerMain() first thing in GUI_APP_MAIN:
+//
+//      if(DecodePool::WorkerMain()) return;
+//----------------------------------------------------------------------------
+class DecodePool {
+public:
+    typedef Function<void (ThumbResult&)> Sink;   // called on the pool thread
+
+    static void  Start(int workers = 0, int timeout_ms = 5000, int max_edge = 256); // 0 = CPU cores
+    static void  Stop();
+    static bool  IsRunning();
+    static int   GetWorkers();          // workers up now; 0 while none can start
+    static bool  WorkerMain();          // true if this process ran as a worker
+
+    static int64 NewOwner(Sink sink);
+    static void  Submit(int64 owner, int index, int gen, const String& path, const String& key);
+    static void  Cancel(int64 owner);   // forget queued jobs
+    static void  Release(int64 owner);  // Cancel + never call the owner's sink again
+
+    static int64 GetDecoded();
+    static int64 GetFailed();
+    static int64 GetRestarts();
+};
+
+//----------------------------------------------------------------------------
+//  View settings snapshot (per-tab presets, JSON round-trip)
+//----------------------------------------------------------------------------
+struct GalleryViewState : Moveable<GalleryViewState> {
+    int          zoom_i               = 2;
+    int          overview             = 0;      // SetOverview cell px, 0 = off
+    AspectPolicy aspect               = AspectPolicy::Fit;
+    ScrollMode   scroll_mode          = ScrollMode::Auto;
+    int          pad                  = 8;
+    bool         show_sel_ring        = true;
+    bool         show_filter_ring     = true;
+    bool         hover_enabled        = true;
+    bool         saturation_on        = true;
+    int          label_backdrop_alpha = 170;
+    int          badge_min_zoom       = 1;
+    bool         adaptive_quality     = false;
+    bool         density_strip        = false;
+    dword        lod[CT::ZOOM_COUNT]  = { 0, LOD_ALL & ~LOD_SEL_TINT, LOD_ALL, LOD_ALL, LOD_ALL };
+    String       label_preset         = "name"; // CT::PRESETS name, or empty ...
+    String       label_template;                // ... to use this SetLabelTemplate spec
 };
 
 //----------------------------------------------------------------------------
@@ -59,13 +231,48 @@ class GalleryCtrl : public Ctrl {
 public:
     // --- Construction
     GalleryCtrl();
+    ~GalleryCtrl();
 
     // --- Items & Images
     int   Add(const String& name, const Image& opt_img = Image(), Color tint = Null);
+    int   Add(String&& name, Image&& img = Image(), Color tint = Null);      // adopts both
+    int   Add(String&& name, ImageBuffer&& ib, Color tint = Null);          // adopts the pixels
+    int   AddBatch(Vector<GalleryNewItem>&& batch);   // one sync / reflow; -> first index
     void  AddDummy(const String& name);
 
-    bool  SetThumbFromFile(int index, const String& filepath);
+    bool  SetThumbFromFile(int index, const String& filepath);   // via ThumbCache / DecodePool
     void  SetThumbImage(int index, const Image& img);
+    void  SetThumbImage(int index, Image&& img);
+    void  SetThumbImage(int index, ImageBuffer&& ib);
+    bool  SetThumbShared(int index, const String& key);          // cached image, false if absent
+    void  SetThumbShared(int index, const String& key, const Image& img); // publish + use
+
+    // --- Async completion (thread safe; applied on the GUI thread once per frame)
+    void  PostThumb(int index, Image img, const String& key = Null);
+    void  PostThumbStatus(int index, ThumbStatus s);
+
+    // --- Compact previews (BlurHash strings, shown until the thumbnail is Ok)
+    void   SetPreviewHash(int index, const String& hash);
+    String GetPreviewHash(int index) const;              // encoded once a thumb arrives
+    static String EncodePreviewHash(const Image& img, int cx = 4, int cy = 3); // ~28 bytes
+    static Image  DecodePreviewHash(const String& hash, Size sz = Size(32, 32));
+
+    // --- Adaptive quality: cheap tiles while scrolling fast, refined once settled
+    void  SetAdaptiveQuality(bool b);
+    bool  GetAdaptiveQuality() const          { return adaptive_quality; }
+    void  SetFastScrollSpeed(int px_per_sec)  { fast_scroll_speed = max(px_per_sec, 1); }
+    int   GetFastScrollSpeed() const          { return fast_scroll_speed; }
+    bool  IsFastScrolling() const             { return fast_scroll; }
+
+    // --- Idle work (async results, gray conversion, glyphs, text layout)
+    void  SetIdleBudget(int usecs)            { idle_budget_us = max(usecs, 100); } // per tick
+    int   GetIdleBudget() const               { return idle_budget_us; }
+    bool  IsIdleBusy() const                  { return idle_pending != 0; }
+    void  FlushIdle();                        // run all pending work now (tests, captures)
+
+    // --- Tile layers (gray and prescaled copies; pixels come from TilePool)
+    void  SetLayerLimit(int items)            { layer_limit = items; TrimLayers(); } // 0 = auto, < 0 = no limit
+    int   GetLayerLimit() const               { return layer_limit; }
     void  ClearThumbImage(int index);
 
     // --- Status & Data Flags
@@ -73,13 +280,78 @@ public:
     void      SetDataFlags(int index, DataFlags f);
     DataFlags GetDataFlags(int index) const;
 
+    // bulk variants: one pass, one repaint of the touched rows; flags = (old & ~mask) | (f & mask)
+    void      SetThumbStatus(int from, int count, ThumbStatus s);
+    void      SetThumbStatus(const Vector<int>& indices, ThumbStatus s);
+    void      SetThumbStatus(const PackedBits& which, ThumbStatus s);
+    void      SetDataFlags(int from, int count, DataFlags f, DataFlags mask = DataFlags(~0u));
+    void      SetDataFlags(const Vector<int>& indices, DataFlags f, DataFlags mask = DataFlags(~0u));
+    void      SetDataFlags(const PackedBits& which, DataFlags f, DataFlags mask = DataFlags(~0u));
+
+    // --- Status / flag glyph mapping (built-in GlyphType or RegisterGlyph id; -1 = none)
+    void  SetStatusGlyph(ThumbStatus s, int glyph);
+    int   GetStatusGlyph(ThumbStatus s) const;
+    void  SetFlagGlyph(DataFlags flag, int glyph);     // single DF_* bit
+    int   GetFlagGlyph(DataFlags flag) const;
+
+    // --- Badge layer
+    int   AddBadge(BadgeSource src, unsigned key, int glyph, BadgeCorner corner = BadgeCorner::TopLeft);
+    void  ClearBadges();
+    int   GetBadgeCount() const              { return badge_rules.GetCount(); }
+    const BadgeRule& GetBadge(int i) const   { return badge_rules[i]; }
+    void  SetItemBadges(int index, dword bits);
+    dword GetItemBadges(int index) const;
+    void  SetBadgeMinZoom(int zi);           // badges are skipped below this zoom step
+    int   GetBadgeMinZoom() const            { return badge_min_zoom; }
+
     // --- Selection & Filtering
     Vector<int> GetSelection() const;
+    void        GetSelection(Vector<int>& out) const;   // into out, reusing its storage
     void        ClearSelection();
 
     void  SetFiltered(int index, bool filtered_out);
+    void  SetFiltered(int from, int count, bool filtered_out);
+    void  SetFiltered(const Vector<int>& indices, bool filtered_out);
+    void  SetFiltered(const PackedBits& which, bool filtered_out);
     void  ClearFilterFlags();
 
+    // --- Order (permutes items with all their columns; item indices change)
+    bool  SetOrder(const Vector<int>& order);        // order[k] = current index of new item k
+    void  SortByName(bool descending = false);      // natural order: "Item 2" < "Item 10"
+    static String NaturalKey(const String& name);   // memcmp-ordered collation key
+    void  SortBySimilarity();                       // Hilbert order of color + dHash features
+
+    // --- Near duplicates (64-bit dHash per thumbnail, computed in the background)
+    static uint64 PerceptualHash(const Image& img);
+    uint64 GetPerceptualHash(int index) const;
+    bool   HasPerceptualHash(int index) const;
+    Vector<Vector<int>> FindDuplicateGroups(int max_dist = 6);   // Hamming distance 0..11
+    Vector<int> FindDuplicates(const Vector<int>& of, int max_dist = 6); // includes 'of'
+    void   SelectDuplicatesOfSelection(int max_dist = 6);
+
+    // --- Color filter (64-bin HSV histogram per thumbnail, computed in the background)
+    enum { HIST_BINS = 64 };
+    static void  ColorHistogram(const Image& img, byte* out);    // HIST_BINS shares, sum ~255
+    Vector<byte> GetColorHistogram(int index) const;             // empty until computed
+    void  SetColorFilter(Color c, int min_score = 48);            // hides items below score 0..255
+    void  SetColorFilterLike(int index, int min_score = 128);     // colors like this item's
+
+    // --- Facets (bit column + live count per ThumbStatus value and DF_* bit)
+    int   GetStatusCount(ThumbStatus s) const;              // O(1)
+    int   GetFlagCount(DataFlags flag) const;               // single DF_* bit, O(1)
+    const PackedBits& GetStatusBits(ThumbStatus s) const;
+    PackedBits GetFlagBits(DataFlags mask) const;           // items with any of these bits
+    const PackedBits& GetSelectionBits() const  { return sel_bits; }
+    const PackedBits& GetFilteredBits() const   { return filt_bits; }
+    void  SelectBits(const PackedBits& bits);               // e.g. Error AND NOT TagMissing
+    void  FilterBits(const PackedBits& keep);               // all others are filtered out
+
+    // --- Type-ahead find (typed prefix selects the matching item; sorted name index)
+    void  SetTypeAhead(bool b);                          // default off; on makes the control focusable
+    bool  GetTypeAhead() const                { return type_ahead; }
+    int   FindNamePrefix(const String& prefix, int after = -1); // next match in name order, -1 if none
+    void  ScrollToItem(int index);
+
     // --- Zoom & Aspect
     void        SetZoomIndex(int zi); // 0..(N-1)
     int         GetZoomIndex() const { return zoom_i; }
@@ -101,6 +373,35 @@ public:
     void  SetLabelBackdropAlpha(int a); // 0..255 simulated
     int   GetLabelBackdropAlpha() const { return label_backdrop_alpha; }
 
+    // --- Overview (cells below the smallest zoom step, one average color per item)
+    void  SetOverview(int cell_px);           // 2..8 px, 0 = off (normal tiles)
+    int   GetOverview() const                 { return overview; }
+
+    // --- Density strip next to the scrollbar (selected / filter matches / flagged)
+    void  SetDensityStrip(bool b);
+    bool  GetDensityStrip() const             { return density_on; }
+
+    // --- Level of detail (LodLayer bits per zoom step; smallest steps skip most layers)
+    void  SetLod(int zoom_step, dword layers);
+    dword GetLod(int zoom_step) const;
+
+    // --- Label layout (CT presets, see GalleryLayout.h)
+    void  SetLabelLayout(const CT::Table& t);
+    bool  SetLabelPreset(const String& name);            // CT::PRESETS name
+    const CT::Table& GetLabelLayout() const { return label_layout; }
+    String GetLabelPreset() const           { return label_preset; } // empty if custom
+    void  SetLabelTemplate(const String& spec); // e.g. "name; frames, version; status"
+
+    // --- Metadata fields (columnar per-item values, referenced by label layouts)
+    int    AddField(const String& id, FieldType type = FieldType::Text); // -> field index
+    int    FindField(const String& id) const;
+    int    GetFieldCount() const                { return fields.GetCount(); }
+    void   SetField(int index, int field, const String& v);
+    void   SetField(int index, int field, int64 v);
+    void   SetField(int index, int field, double v);
+    void   SetFieldRange(int index, int field, int64 from, int64 to);
+    String GetFieldText(int index, int field) const;
+
     // --- Layout & scroll
     void        SetScrollMode(ScrollMode m);
     ScrollMode  GetScrollMode() const { return scroll_mode; }
@@ -108,8 +409,15 @@ public:
     int         GetTilePadding() const { return pad; }
 
     int         GetCount() const { return items.GetCount(); }
+    String      GetName(int index) const { return items[index].name; }
     void        Clear();
 
+    // --- View presets (applied atomically: one reflow, one repaint)
+    GalleryViewState GetViewState() const;
+    void        SetViewState(const GalleryViewState& s);
+    String      SavePreset() const;                 // JSON
+    bool        LoadPreset(const String& json);     // missing keys keep current values
+
     // --- Events
     Gate1<const Vector<int>&> WhenSelecting;      // return false to veto
     Event<>                   WhenSelection;      // after commit
@@ -117,6 +425,7 @@ public:
     Event<int>                WhenZoom;           // zoom index changed
     Event<int>                WhenCaret;          // anchor index moved
     Event<int>                WhenHover;          // hover index (or -1)
+    Event<const Vector<int>&> WhenOrder;          // after SetOrder, order[new] = old
     Event<Bar&>               WhenBar;            // extend context menu
 
     // --- Glyph accessors (compat with spec)
@@ -126,10 +435,16 @@ public:
 
     // --- Procedural demo tools (kept in lib while developing)
     static Image GenRandomThumb(int edge_px, int aspect_w = 0, int aspect_h = 0, uint32 seed = 0);
-    static const Image& Glyph(GlyphType type, int tile);
+    static const Image& Glyph(int type, int tile);     // GlyphType or runtime id
     static Image GenThumbWithGlyph(GlyphType type, int edge_px, uint32 seed = 0);
     static void  FillWithRandom(GalleryCtrl& dst, int count, int thumb_edge_px, uint32 seed_base = 0);
 
+    // --- Runtime glyphs (GlyphGenerator JSON documents, shared by all controls)
+    static int  RegisterGlyph(const String& name, const String& json); // glyph id or -1; same name replaces
+    static int  RegisterGlyphFile(const String& name, const String& path);
+    static int  FindGlyph(const String& name);                         // -1 if unknown
+    static int  GetGlyphCount();                                       // built-ins + registered
+
 private:
     // ---- Ctrl overrides ----
     void   Paint(Draw& w) override;
@@ -147,16 +462,166 @@ private:
     void   Reflow();
     Rect   TileRect(int index) const;          // tile rect in CONTENT coords
     Rect   ImageRect(const Rect& tile) const;  // image box within tile
+    Color  PlaceholderTint(const GalleryItem& it) const;  // item tint or hue from the name
+    Size   ThumbDrawSize(Size isz, const Rect& ri) const; // thumb size in image box (aspect policy)
+    template <AspectPolicy A>
+    static Size DrawSize(Size isz, Size box) {          // ThumbDrawSize for a fixed policy
+        if(A == AspectPolicy::Stretch || isz.cx <= 0 || isz.cy <= 0)
+            return box;
+        const double sx = (double)box.cx / isz.cx, sy = (double)box.cy / isz.cy;
+        const double s  = A == AspectPolicy::Fit ? min(sx, sy) : max(sx, sy);
+        return Size(int(isz.cx * s + 0.5), int(isz.cy * s + 0.5));
+    }
+    int    CellW() const { return overview ? overview : ZoomSteps()[zoom_i]; }
+    int    CellH() const { return overview ? overview : ZoomSteps()[zoom_i] + band_before + band_after; }
+    int    Gap() const   { return overview ? 0 : pad; }
     int    IndexFromPoint(Point content_pt) const; // -1 if gap or outside
 
     // ---- Selection helpers ----
     GalleryItem*       TryItem(int i)       { return (i >= 0 && i < items.GetCount()) ? &items[i] : nullptr; }
     const GalleryItem* TryItem(int i) const { return (i >= 0 && i < items.GetCount()) ? &items[i] : nullptr; }
     void   CommitSelection(const Vector<int>& indices);
-    Vector<int> IndicesInRect(const Rect& rc) const;  // tiles intersecting rect (CONTENT coords)
+    void   CommitSelection(const PackedBits& want);    // changed bits only
+    void   IndicesInRect(const Rect& rc, PackedBits& out) const; // sets tiles intersecting rect (CONTENT coords)
     static Rect NormalizeRect(Rect r);
     
     void ApplyMarqueeSelection(bool add, bool sub, bool inter, bool xr);
+
+    // ---- Shared thumbnails (ThumbCache.cpp) ----
+    void   ReleaseThumb(GalleryItem& it);              // drop the item's cache reference
+    void   AssignThumb(GalleryItem& it, const Image& img, const String& key); // no refresh
+    bool   DecodeThumbHere(int index, const String& path, const String& key); // in-process
+
+    // ---- Tile layers (TilePool.cpp) ----
+    void   NoteLayer(int index);                       // item just got a gray / mip copy
+    void   TrimLayers();                               // recycle layers of far-away items
+    void   DropLayers(GalleryItem& it);                // recycle one item's layers
+    void   DropLayers();                               // ... every item's
+
+    // ---- Async completion (Async.cpp) ----
+    void   PushResult(ThumbResult& r);                 // any thread
+    bool   DrainSlice();                               // apply a few results; true if more
+
+    // ---- Idle scheduler (Idle.cpp) ----
+    enum { TIMEID_IDLE = Ctrl::TIMEID_COUNT, TIMEID_SETTLE, TIMEID_COUNT };
+    enum IdleTask { TASK_RESULTS, TASK_AVG, TASK_GRAY, TASK_REFINE, TASK_GLYPHS, TASK_TEXT, TASK__COUNT }; // by priority
+    void   Schedule(IdleTask t);
+    void   IdleTick();
+    bool   IdleSlice(IdleTask t);                      // one small step; false when done
+    bool   GraySlice();                                // GalleryCtrl.cpp
+    void   DirtyTile(int index);
+    void   FlushDirty();
+    void   QueueTextRows(int first_row, int last_row);
+
+    // ---- Overview (Overview.cpp) ----
+    void   ThumbChanged(int index);                    // queue average color update
+    bool   AverageSlice();
+    void   PaintOverview(Draw& w);
+    const Image& PreviewImage(int index);              // Preview.cpp; decoded, cached
+
+    // ---- Density strip (Density.cpp) ----
+    struct DensityStrip : Ctrl {
+        GalleryCtrl* owner = nullptr;
+        void Paint(Draw& w) override;
+        void LeftDown(Point p, dword) override;
+        void MouseMove(Point p, dword keyflags) override;
+    };
+    void   MarkSelected(int index, bool b);            // item flag + bit column + bucket
+    void   MarkFiltered(int index, bool b);
+    void   MarkFlagged(int index, bool b);
+    void   DensityDelta(Vector<int>& bucket, int& total, int index, int d);
+    void   RebuildDensity(int nbuckets);
+    void   PaintDensity(Draw& w, Size sz);
+    void   DensityJump(int y, int height);
+
+    // ---- Near duplicates (Duplicates.cpp) ----
+    struct HashIndex;
+
+    // ---- Color filter (ColorFilter.cpp) ----
+    void   ApplyColorFilter(const byte* query, int min_score);
+
+    // ---- Facets (Facets.cpp) ----
+    enum { STATUS_COUNT = (int)ThumbStatus::Error + 1 };
+    static int FlagBit(DataFlags f);                   // GalleryCtrl.cpp
+    void   SyncFacets();
+    void   MarkStatus(int index, ThumbStatus s);        // only writers of status / flags
+    void   MarkFlags(int index, DataFlags f);
+    void   ApplyFiltered(const PackedBits& out);        // filtered_out := out, changed bits only
+    void   RefreshSpan(int lo, int hi);                 // Bulk.cpp; rows of items lo..hi, clipped
+
+    // ---- Type-ahead (TypeAhead.cpp) ----
+    void   SyncNameIndex();
+    void   NamePrefixRange(const String& prefix, int& lo, int& hi);
+    bool   TypeAheadKey(dword key);
+    void   PaintRubberBand(Draw& w);                   // GalleryCtrl.cpp
+
+    // ---- Tile paint passes (GalleryCtrl.cpp, after Paint) ----
+    struct PaintFrame {
+        int   first, end;                              // visible items
+        Size  box;                                     // image box of every tile
+        dword ld;                                      // LodLayer bits of the zoom step
+        bool  fast, labels, rings, badges;
+        Color back;                                    // label backdrop
+    };
+    enum TileKind {                                    // how a tile's image is drawn
+        TK_MIP, TK_SCALED, TK_GRAY_PENDING,            // thumbnail, settled
+        TK_FAST_MIP, TK_FAST_SCALED, TK_FAST_TINT,     // thumbnail, fast scroll
+        TK_PREVIEW, TK_PREVIEW_FILTERED, TK_GLYPH, TK_TINT,
+        TK__COUNT
+    };
+    void   PaintTiles(Draw& w, const PaintFrame& f);
+    template <AspectPolicy A> void PaintTiles(Draw& w, const PaintFrame& f, Vector<int>* bucket[TK__COUNT]);
+    template <AspectPolicy A> void ClassifyTiles(const PaintFrame& f, Vector<int>* bucket[TK__COUNT]);
+    template <int KIND, AspectPolicy A> void PaintBucket(Draw& w, const PaintFrame& f, const Vector<int>& tiles);
+    template <bool TINT, bool RING> void PaintSelected(Draw& w, const PaintFrame& f);
+    void   PaintOverlay(Draw& w, const Rect& r, Color c, int alpha); // no allocation once warm
+
+    // ---- Adaptive quality (Adaptive.cpp) ----
+    void   NoteScroll(int dx, int dy);
+    void   SettleScroll();
+    bool   RefineSlice();
+
+    // ---- Glyph cache ----
+    static ArrayMap<int, Image>& GlyphCache();         // key = (type<<16) | size
+    static Image RenderGlyphDoc(int id, int tile);     // GlyphDoc.cpp
+    static int   GlyphGeneration();                    // bumped when a registered glyph is replaced
+    void   PrewarmGlyphs();                            // rasterize mapped glyphs for current tile
+
+    // ---- Badge layer (Badges.cpp) ----
+    struct BadgeDraw : Moveable<BadgeDraw> { int x, y, slot; };
+    int    BadgeSize() const;
+    void   BuildBadgeAtlas();
+    void   QueueBadges(const GalleryItem& it, const Rect& ri);
+    void   PaintBadges(Draw& w);
+
+    // ---- Label layout (Labels.cpp) ----
+    enum { FIELD_NONE = -1, FIELD_NAME = -2, FIELD_INDEX = -3, FIELD_STATUS = -4, FIELD_FLAGS = -5 };
+    int    FieldId(const char* field) const;
+    void   SyncLabelLayout();                          // bind fields, band heights for zoom_i
+    bool   AssignLabelPreset(const String& name);      // table only, no reflow
+    void   AssignLabelTemplate(const String& spec);    // table only, no reflow
+    int    LabelIconGlyph(const GalleryItem& it, int field) const;
+    void   PaintLabels(Draw& w, int index, const GalleryItem& it, const Rect& rt, Color back);
+
+    // ---- Metadata fields (Fields.cpp) ----
+    struct MetaField {
+        String         id;
+        FieldType      type = FieldType::Text;
+        Vector<String> text;            // Text
+        Vector<int64>  num, num2;       // Int; Range = [num, num2]
+        Vector<double> real;            // Real
+        void SetCount(int n);
+        void Clear()                    { SetCount(0); }
+    };
+    struct TextFit : Moveable<TextFit> {
+        int64  a = 0, b = 0;            // numeric value (collision check)
+        String text;                    // string value (collision check)
+        String shown;                   // text as drawn (elided when needed)
+        int    width = 0;               // width of shown
+        bool   clip = false;            // overflows a non-eliding box
+    };
+    void   SyncFields();                               // columns follow items.GetCount()
+    const TextFit& FitText(int field, int index, const GalleryItem& it, const CT::Box& bx);
 	void SetCtrlMarqueeXor(bool on) { ctrl_marquee_xor = on; }
 	bool GetCtrlMarqueeXor() const  { return ctrl_marquee_xor; }
 
@@ -169,7 +634,8 @@ private:
 
     // geometry
     int   pad = 8;                  // pixel gap between tiles
-    int   label_h = 18;             // bottom label bar height
+    int   band_before = 0;          // label bands above / below the image
+    int   band_after  = CT::LINE_PX;  // (from label_layout at the current zoom step)
     int   cols = 1;
     int   rows = 0;
     int   content_w = 0;
@@ -188,6 +654,103 @@ private:
 
     int   label_backdrop_alpha = 170; // 0..255 simulated alpha
 
+    dword lod[CT::ZOOM_COUNT] = { 0, LOD_ALL & ~LOD_SEL_TINT, LOD_ALL, LOD_ALL, LOD_ALL };
+
+    // label layout: precompiled boxes + field ids bound for every zoom step
+    CT::Table label_layout = CT::PRESET_NAME;
+    String    label_preset = "name";
+    int       label_field[CT::ZOOM_COUNT][CT::MAX_BOXES];
+    String    label_template_spec;         // SetLabelTemplate spec of the current table
+
+    // metadata columns + text measurement cache (value, zoom step, box width)
+    Array<MetaField>           fields;
+    VectorMap<uint64, TextFit> text_fit;
+
+    // glyph mapping (indexed by ThumbStatus / DF_* bit number)
+    int   status_glyph[5] = { -1, GLYPH_PLACEHOLDER, GLYPH_MISSING, -1, GLYPH_ERROR };
+    int   flag_glyph[32];
+
+    // badges: rules + one atlas image per badge size, drawn in a single pass
+    Vector<BadgeRule> badge_rules;
+    int               badge_min_zoom = 1;
+    int               flag_slot[32];
+    Image             badge_atlas;
+    int               badge_atlas_size = 0;
+    int               badge_atlas_gen = -1;     // GlyphGeneration() the atlas was built from
+    Vector<BadgeDraw> badge_batch;
+
+    // async completion: producers push, the GUI thread drains once per frame
+    MpscQueue<ThumbResult> done_queue;
+    std::atomic<int>       done_count { 0 };    // pushed, not yet drained
+    std::shared_ptr<bool>  alive;               // guards posted drain callbacks
+    int64                  decode_owner = 0;
+    int                    item_gen = 0;        // bumped by Clear(); stale results are dropped
+
+    // idle scheduler: pending task bits, per-tick budget, tiles to repaint after a tick
+    dword         idle_pending = 0;
+    int           idle_budget_us = 4000;
+    Vector<int>   idle_dirty;
+    Vector<Point> glyph_todo;                   // (glyph id, size) still to rasterize
+    Vector<int>   text_todo;                    // rows to pre-measure
+    int           paint_first_row = 0, paint_last_row = -1;
+    int           text_first_row = 0,  text_last_row = -1;
+
+    // overview: cell size (0 = off), per-item average color column (a = 0: none yet)
+    int           overview = 0;
+    Vector<RGBA>  avg_color;
+    Vector<int>   avg_todo;
+    int           avg_batch = 16;               // AverageSlice batch, adapted to idle_budget_us
+
+    // feature columns, valid where phash_bits is set (computed with avg_color):
+    // perceptual hash, and HIST_BINS bytes of color histogram per item
+    Vector<uint64> phash;
+    PackedBits     phash_bits;
+    Vector<byte>   color_hist;
+
+    // compact previews: per-item hash column, decoded images of recently painted items
+    Vector<String>       preview_hash;
+    ArrayMap<int, Image> preview_cache;
+
+    // density strip: packed per-item columns mirrored from GalleryItem, and
+    // per-bucket popcounts for the (cols, rows, buckets) they were built for
+    PackedBits    sel_bits, filt_bits, flag_bits;
+    FrameRight<DensityStrip> density;
+    bool          density_on = false;
+    int           density_cols = -1, density_rows = -1;
+    Vector<int>   density_sel, density_filt, density_flag;
+    int           density_sel_total = 0, density_filt_total = 0, density_flag_total = 0;
+
+    // facet indexes
+    PackedBits    status_bits[STATUS_COUNT];
+    int           status_count[STATUS_COUNT] = {};
+    PackedBits    flag_index[32];               // by DF_* bit number
+    int           flag_count[32] = {};
+
+    // type-ahead: typed prefix, and the lower-cased name index (rebuilt lazily)
+    bool           type_ahead = false;
+    WString        typed;
+    int64          typed_ms = 0;
+    bool           name_index_dirty = true;
+    Vector<int>    name_order;                  // item indices by name
+    Vector<int>    name_rank;                   // item index -> position in name_order
+    Vector<String> name_sorted;                 // lower-cased names, name_order order
+
+    // item order: natural-order name keys (set on Add), and for each recent
+    // generation the map from its indices to the current ones (-1 = gone)
+    Vector<String>            name_key;
+    VectorMap<int, Vector<int>> gen_remap;
+
+    // tile layers: items holding a gray / mip copy, oldest first (may repeat)
+    BiVector<int> layer_ring;
+    int           layer_limit = 0;
+
+    // adaptive quality: scroll velocity (px/s, smoothed) and fast-scroll state
+    bool   adaptive_quality  = false;
+    bool   fast_scroll       = false;
+    int    fast_scroll_speed = 2500;
+    double scroll_speed      = 0;
+    int64  last_scroll_us    = 0;
+
     // interaction
     int   hover_index  = -1;
     int   anchor_index = -1;
@@ -213,7 +776,12 @@ private:
 
     Point drag_origin_win;
     Rect  drag_rect_win;
-    Vector<int> drag_prev_sel;
+    PackedBits drag_prev_sel;                   // selection when the drag began
+
+    // per-event / per-frame temporaries (Scope per handler), and translucent
+    // fill swatches by (color, alpha), tiled by PaintOverlay
+    ScratchArena            scratch;
+    VectorMap<int64, Image> overlay_swatch;
 
     // zoom step lookup (longest side)
     static const int* ZoomSteps();
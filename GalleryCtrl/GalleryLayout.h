@@ -0,0 +1,217 @@
+#ifndef _GalleryCtrl_GalleryLayout_h_
+#define _GalleryCtrl_GalleryLayout_h_
+
+#include <array>
+
+namespace Upp {
+
+//----------------------------------------------------------------------------
+//  Tile label layout presets (compile-time)
+//
+//  A Layout describes lines of segments in three regions of a tile:
+//  Before (band above the image), Overlay (on the image) and After (band
+//  below the image). Compile() resolves a Layout for every zoom step into a
+//  Table of fixed tile-relative boxes, so painting a preset is a table walk.
+//----------------------------------------------------------------------------
+namespace CT {
+
+constexpr int ZOOM_STEP_PX[] = { 32, 48, 64, 96, 128 };   // longest side per zoom step
+constexpr int ZOOM_COUNT     = 5;
+constexpr int LINE_PX        = 18;  // default line height (classic label bar)
+constexpr int TEXT_PAD       = 4;   // horizontal inset of a content line
+constexpr int MAX_BOXES      = 12;  // resolved segments per zoom step
+
+enum class Orientation { Horizontal, Vertical };   // segments side by side / stacked
+enum class Region      { Before, Overlay, After };
+enum class LineType    { Content, Spacer };
+enum class LineDiv     { D1 = 1, D2, D3 };         // number of segments used
+enum class SegmentType { None, Icon, Text, Spacer };
+
+struct Segment {
+    SegmentType type   = SegmentType::None;
+    const char* field  = nullptr;  // "name", "index", "status", "flags" or a metadata field id;
+                                   // static storage only (literal or interned), tables are copied
+    int         width  = 0;        // fixed px; 0 = icon: square, text/spacer: flexible
+    int         weight = 0;        // share of the flexible width (0 = 1)
+    bool        elide  = false;    // ellipsis instead of clipping
+    int         align  = -1;       // -1 left, 0 center, +1 right
+};
+
+struct Line {
+    LineType type     = LineType::Content;
+    LineDiv  div      = LineDiv::D1;
+    Segment  seg[3]   = {};
+    int      min_tile = 0;         // hidden on zoom steps smaller than this
+    int      height   = 0;         // px; 0 = LINE_PX
+};
+
+template <size_t NB, size_t NO, size_t NA>
+struct Layout {
+    Orientation          orientation = Orientation::Horizontal;
+    std::array<Line, NB> before  = {};
+    std::array<Line, NO> overlay = {};
+    std::array<Line, NA> after   = {};
+};
+
+// One resolved segment, in tile coordinates (tile origin = top-left of the before band)
+struct Box {
+    SegmentType type  = SegmentType::None;
+    Region      region = Region::After;
+    const char* field = nullptr;
+    short       x = 0, y = 0, cx = 0, cy = 0;
+    bool        elide = false;
+    signed char align = -1;
+};
+
+struct Step {
+    int before_h = 0;              // band heights; the image sits between them
+    int after_h  = 0;
+    int count    = 0;
+    Box box[MAX_BOXES] = {};
+};
+
+struct Table {
+    Step step[ZOOM_COUNT] = {};
+};
+
+// ---- compiler ---------------------------------------------------------------
+constexpr int LineHeight(const Line& l) { return l.height > 0 ? l.height : LINE_PX; }
+
+constexpr void AddBox(Step& st, const Segment& s, Region rg, int x, int y, int cx, int cy)
+{
+    if(st.count >= MAX_BOXES || cx <= 0 || cy <= 0 || s.type == SegmentType::Spacer)
+        return;
+    Box& b = st.box[st.count++];
+    b.type   = s.type;
+    b.region = rg;
+    b.field  = s.field;
+    b.x = (short)x; b.y = (short)y; b.cx = (short)cx; b.cy = (short)cy;
+    b.elide  = s.elide;
+    b.align  = (signed char)s.align;
+}
+
+constexpr int PlaceLine(Step& st, const Line& l, Region rg, Orientation o, int tile, int y)
+{
+    const int h = LineHeight(l);
+    if(l.type == LineType::Spacer)
+        return h;
+
+    const int n = (int)l.div;
+    if(o == Orientation::Vertical) {            // one segment per row
+        for(int i = 0; i < n; ++i)
+            AddBox(st, l.seg[i], rg, TEXT_PAD, y + i * h, tile - 2 * TEXT_PAD, h);
+        return n * h;
+    }
+
+    int fixed = 0, weights = 0;
+    for(int i = 0; i < n; ++i) {
+        const Segment& s = l.seg[i];
+        if(s.width > 0)                    fixed += s.width;
+        else if(s.type == SegmentType::Icon) fixed += h;
+        else                               weights += s.weight > 0 ? s.weight : 1;
+    }
+    const int flex = tile - 2 * TEXT_PAD - fixed;
+    int x = TEXT_PAD;
+    for(int i = 0; i < n; ++i) {
+        const Segment& s = l.seg[i];
+        int cx = s.width > 0 ? s.width
+               : s.type == SegmentType::Icon ? h
+               : (flex > 0 && weights > 0 ? flex * (s.weight > 0 ? s.weight : 1) / weights : 0);
+        if(x + cx > tile - TEXT_PAD) cx = tile - TEXT_PAD - x;
+        AddBox(st, s, rg, x, y, cx, h);
+        x += cx > 0 ? cx : 0;
+    }
+    return h;
+}
+
+template <size_t N>
+constexpr int RegionHeight(const std::array<Line, N>& lines, Orientation o, int tile)
+{
+    int h = 0;
+    for(size_t i = 0; i < N; ++i)
+        if(tile >= lines[i].min_tile)
+            h += o == Orientation::Vertical && lines[i].type == LineType::Content
+                 ? (int)lines[i].div * LineHeight(lines[i]) : LineHeight(lines[i]);
+    return h;
+}
+
+template <size_t N>
+constexpr void PlaceRegion(Step& st, const std::array<Line, N>& lines, Region rg, Orientation o, int tile, int y)
+{
+    for(size_t i = 0; i < N; ++i)
+        if(tile >= lines[i].min_tile)
+            y += PlaceLine(st, lines[i], rg, o, tile, y);
+}
+
+template <size_t NB, size_t NO, size_t NA>
+constexpr Table Compile(const Layout<NB, NO, NA>& l)
+{
+    Table t{};
+    for(int z = 0; z < ZOOM_COUNT; ++z) {
+        const int tile = ZOOM_STEP_PX[z];
+        Step& st = t.step[z];
+        st.before_h = RegionHeight(l.before, l.orientation, tile);
+        st.after_h  = RegionHeight(l.after, l.orientation, tile);
+        const int ov_h = RegionHeight(l.overlay, l.orientation, tile);
+
+        PlaceRegion(st, l.before,  Region::Before,  l.orientation, tile, 0);
+        PlaceRegion(st, l.overlay, Region::Overlay, l.orientation, tile, st.before_h + (tile - ov_h) / 2);
+        PlaceRegion(st, l.after,   Region::After,   l.orientation, tile, st.before_h + tile);
+    }
+    return t;
+}
+
+// ---- built-in presets -------------------------------------------------------
+inline constexpr Segment SEG_SPACER { SegmentType::Spacer, nullptr, 0, 1, false, 0 };
+
+// Classic single label line under the image
+inline constexpr Layout<0, 0, 1> LAYOUT_NAME {
+    Orientation::Horizontal, {}, {},
+    { Line{ LineType::Content, LineDiv::D1,
+            { Segment{ SegmentType::Text, "name", 0, 1, true, -1 } } } }
+};
+
+// Status icon + name under the image
+inline constexpr Layout<0, 0, 1> LAYOUT_STATUS_NAME {
+    Orientation::Horizontal, {}, {},
+    { Line{ LineType::Content, LineDiv::D2,
+            { Segment{ SegmentType::Icon, "status", 0, 0, false, 0 },
+              Segment{ SegmentType::Text, "name",   0, 1, true, -1 } } } }
+};
+
+// Badge + name above the image, centered watermark on large tiles
+inline constexpr Layout<1, 1, 0> LAYOUT_HORZ_BADGE_WATERMARK {
+    Orientation::Horizontal,
+    { Line{ LineType::Content, LineDiv::D3,
+            { Segment{ SegmentType::Icon, "status", 0, 0, false, 0 },
+              SEG_SPACER,
+              Segment{ SegmentType::Text, "name", 0, 4, true, -1 } }, 0 } },
+    { Line{ LineType::Content, LineDiv::D3,
+            { SEG_SPACER,
+              Segment{ SegmentType::Text, "index", 0, 2, true, 0 },
+              SEG_SPACER }, 96 } },
+    {}
+};
+
+// Image only
+inline constexpr Layout<0, 0, 0> LAYOUT_NONE {};
+
+inline constexpr Table PRESET_NAME                 = Compile(LAYOUT_NAME);
+inline constexpr Table PRESET_STATUS_NAME          = Compile(LAYOUT_STATUS_NAME);
+inline constexpr Table PRESET_HORZ_BADGE_WATERMARK = Compile(LAYOUT_HORZ_BADGE_WATERMARK);
+inline constexpr Table PRESET_NONE                 = Compile(LAYOUT_NONE);
+
+struct Preset { const char* name; const Table* table; };
+
+inline constexpr Preset PRESETS[] = {
+    { "name",            &PRESET_NAME },
+    { "status_name",     &PRESET_STATUS_NAME },
+    { "badge_watermark", &PRESET_HORZ_BADGE_WATERMARK },
+    { "none",            &PRESET_NONE },
+};
+inline constexpr int PRESET_COUNT = (int)(sizeof(PRESETS) / sizeof(PRESETS[0]));
+
+} // namespace CT
+} // namespace Upp
+
+#endif
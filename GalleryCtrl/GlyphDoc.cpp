@@ -0,0 +1,410 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== GlyphGenerator documents ===============================================
+// Runtime mirror of the shape/style records written by
+// examples/GlyphGenerator (Canvas::SaveJson). Geometry is normalized to the
+// inset rect (0..1), exactly as in the editor; documents are rasterized once
+// per tile size by GalleryCtrl::Glyph() and live in the shared glyph cache.
+
+enum { GD_RECT, GD_CIRCLE, GD_LINE, GD_TRIANGLE, GD_CURVE, GD_TEXT };
+
+struct GlyphDocStyle : Moveable<GlyphDocStyle> {
+    Color  fill          = Color(168, 168, 168);
+    Color  stroke        = Color(53, 53, 53);
+    int    stroke_w      = 2;
+    bool   even_odd      = false;
+    bool   enable_fill   = true;
+    bool   enable_stroke = true;
+    String dash;
+    double opacity        = 1.0;
+    double fill_opacity   = 1.0;
+    double stroke_opacity = 1.0;
+
+    bool   outline_enable  = false;
+    bool   outline_outside = true;
+    Color  outline         = Color(255, 0, 0);
+    int    outline_w       = 0;
+    String outline_dash;
+    double outline_opacity = 1.0;
+    int    outline_dx = 0, outline_dy = 0;
+};
+
+struct GlyphDocShape : Moveable<GlyphDocShape> {
+    int           type = GD_RECT;
+    GlyphDocStyle style;
+    double x = 0, y = 0, w = 0, h = 0, rx = 0, ry = 0;   // rect / text origin
+    double cx = 0, cy = 0, r = 0;                        // circle
+    Pointf p1, p2, p3;                                   // line / triangle
+    Pointf a0, a1, c0, c1;                               // curve
+    bool   cubic = true, closed = false;
+    String text, face;                                   // text
+    double size_n = 0.18;
+    bool   bold = false, italic = false;
+};
+
+struct GlyphDoc {
+    String                name;
+    bool                  clip = true;
+    int                   aspect_ix = 0;
+    bool                  bg_enabled = false;
+    Color                 bg;
+    Vector<GlyphDocShape> shapes;
+};
+
+static Array<GlyphDoc>& s_glyph_docs()  { static Array<GlyphDoc> d; return d; }
+static Index<String>&   s_glyph_names() { static Index<String> n; return n; }
+static int&             s_glyph_gen()   { static int g; return g; }
+
+// ---- JSON helpers (same tolerance rules as the editor) ----------------------
+static inline int    s_vi(const ValueMap& m, const char* k, int d)    { Value v = m[k]; return IsNumber(v) ? (int)v : d; }
+static inline double s_vd(const ValueMap& m, const char* k, double d) { Value v = m[k]; return IsNumber(v) ? (double)v : d; }
+static inline bool   s_vb(const ValueMap& m, const char* k, bool d)   { Value v = m[k]; return IsNumber(v) ? (int)v != 0 : d; }
+static inline String s_vs(const ValueMap& m, const char* k, const String& d) { Value v = m[k]; return IsString(v) ? (String)v : d; }
+
+// Editor files may store maps as arrays of {key, value} pairs
+static ValueMap s_as_map(const Value& v)
+{
+    if(IsValueMap(v))
+        return v;
+    ValueMap m;
+    if(!IsValueArray(v))
+        return m;
+    const ValueArray a = v;
+    for(const Value& e : a) {
+        if(!IsValueMap(e)) continue;
+        const ValueMap kv = e;
+        if(kv.Find("key") < 0 || kv.Find("value") < 0) continue;
+        const Value key = kv["key"];
+        const Value val = kv["value"];
+        String skey;
+        if(IsString(key))
+            skey = (String)key;
+        else if(IsValueMap(key) && IsString(ValueMap(key)["value"]))
+            skey = (String)ValueMap(key)["value"];
+        else
+            continue;
+        if(IsValueMap(val) && ValueMap(val).Find("value") >= 0)
+            m.Add(skey, ValueMap(val)["value"]);
+        else
+            m.Add(skey, val);
+    }
+    return m;
+}
+
+static void s_load_style(GlyphDocStyle& s, const ValueMap& m)
+{
+    s.fill            = Color(s_vi(m, "fill_r", 163), s_vi(m, "fill_g", 201), s_vi(m, "fill_b", 168));
+    s.stroke          = Color(s_vi(m, "stroke_r", 30), s_vi(m, "stroke_g", 53), s_vi(m, "stroke_b", 47));
+    s.stroke_w        = s_vi(m, "stroke_w", 2);
+    s.even_odd        = s_vb(m, "evenOdd", false);
+    s.dash            = s_vs(m, "dash", String());
+    s.enable_fill     = s_vb(m, "enableFill", true);
+    s.enable_stroke   = s_vb(m, "enableStroke", true);
+    s.opacity         = s_vd(m, "opacity", 1.0);
+    s.fill_opacity    = s_vd(m, "fillOpacity", 1.0);
+    s.stroke_opacity  = s_vd(m, "strokeOpacity", 1.0);
+    s.outline_enable  = s_vb(m, "outlineEnable", false);
+    s.outline_outside = s_vb(m, "outlineOutside", true);
+    s.outline         = Color(s_vi(m, "outline_r", 255), s_vi(m, "outline_g", 0), s_vi(m, "outline_b", 0));
+    s.outline_w       = s_vi(m, "outline_w", 0);
+    s.outline_opacity = s_vd(m, "outlineOpacity", 1.0);
+    s.outline_dash    = s_vs(m, "outlineDash", String());
+    s.outline_dx      = s_vi(m, "outlineOffsetX", 0);
+    s.outline_dy      = s_vi(m, "outlineOffsetY", 0);
+
+    // Preset line styles are stored as an index when no custom dash is set
+    static const char* presets[] = { "", "12,4", "8,4", "2,4" };
+    if(s.dash.IsEmpty())
+        s.dash = presets[clamp(s_vi(m, "strokeStyle", 0), 0, 3)];
+    if(s.outline_dash.IsEmpty())
+        s.outline_dash = presets[clamp(s_vi(m, "outlineStyle", 0), 0, 3)];
+}
+
+static bool s_load_doc(GlyphDoc& doc, const String& json)
+{
+    const Value v = ParseJSON(json);
+    if(IsNull(v) || IsError(v))
+        return false;
+    const ValueMap root = s_as_map(v);
+    if(!IsValueArray(root["shapes"]))
+        return false;
+
+    doc.clip       = s_vb(root, "clip", true);
+    doc.aspect_ix  = s_vi(root, "aspect_ix", 0);
+    doc.bg_enabled = s_vb(root, "bg_enabled", false);
+    doc.bg         = Color(s_vi(root, "bg_r", 255), s_vi(root, "bg_g", 255), s_vi(root, "bg_b", 255));
+    doc.shapes.Clear();
+
+    const ValueArray a = root["shapes"];
+    for(const Value& e : a) {
+        const ValueMap sh = s_as_map(e);
+        if(sh.IsEmpty()) continue;
+
+        GlyphDocShape& s = doc.shapes.Add();
+        s.type = clamp(s_vi(sh, "type", GD_RECT), (int)GD_RECT, (int)GD_TEXT);
+        const Value st = sh["style"];
+        if(!IsNull(st))
+            s_load_style(s.style, s_as_map(st));
+
+        switch(s.type) {
+        case GD_RECT:
+            s.x  = s_vd(sh, "x", 0);   s.y  = s_vd(sh, "y", 0);
+            s.w  = s_vd(sh, "w", 0);   s.h  = s_vd(sh, "h", 0);
+            s.rx = s_vd(sh, "rxN", 0); s.ry = s_vd(sh, "ryN", 0);
+            break;
+        case GD_CIRCLE:
+            s.cx = s_vd(sh, "cx", 0); s.cy = s_vd(sh, "cy", 0); s.r = s_vd(sh, "r", 0);
+            break;
+        case GD_TRIANGLE:
+            s.p3 = Pointf(s_vd(sh, "p3x", 0), s_vd(sh, "p3y", 0));
+            // fallthrough
+        case GD_LINE:
+            s.p1 = Pointf(s_vd(sh, "p1x", 0), s_vd(sh, "p1y", 0));
+            s.p2 = Pointf(s_vd(sh, "p2x", 0), s_vd(sh, "p2y", 0));
+            break;
+        case GD_CURVE:
+            s.cubic  = s_vb(sh, "cubic", true);
+            s.closed = s_vb(sh, "closed", false);
+            s.a0 = Pointf(s_vd(sh, "a0x", 0), s_vd(sh, "a0y", 0));
+            s.a1 = Pointf(s_vd(sh, "a1x", 0), s_vd(sh, "a1y", 0));
+            s.c0 = Pointf(s_vd(sh, "c0x", 0), s_vd(sh, "c0y", 0));
+            s.c1 = Pointf(s_vd(sh, "c1x", 0), s_vd(sh, "c1y", 0));
+            break;
+        case GD_TEXT:
+            s.x      = s_vd(sh, "x", 0); s.y = s_vd(sh, "y", 0);
+            s.text   = s_vs(sh, "txt", "Text");
+            s.face   = s_vs(sh, "face", String());
+            s.size_n = s_vd(sh, "sizeN", 0.18);
+            s.bold   = s_vb(sh, "bold", false);
+            s.italic = s_vb(sh, "italic", false);
+            break;
+        }
+    }
+    return true;
+}
+
+// ---- rasterizer (mirrors the editor's Pass_Outline / Pass_Fill / Pass_Stroke)
+static inline double s_clamp01(double v) { return v < 0 ? 0 : v > 1 ? 1 : v; }
+static inline double s_nx(const Rect& r, double nx) { return r.left + r.Width()  * nx; }
+static inline double s_ny(const Rect& r, double ny) { return r.top  + r.Height() * ny; }
+static inline double s_nr(const Rect& r, double nr) { return min(r.Width(), r.Height()) * nr; }
+
+static void s_dash(BufferPainter& p, const String& dash)
+{
+    int n = 0;
+    for(const char* s = ~dash; *s;) {
+        while(*s == ' ' || *s == '\t' || *s == ',') s++;
+        char* end = nullptr;
+        double v = strtod(s, &end);
+        if(end == s) break;
+        if(v > 0) n++;
+        s = end;
+    }
+    if(n >= 2)
+        p.Dash(dash, 0.0);
+}
+
+static void s_pass_outline(BufferPainter& p, const Function<void ()>& build, const GlyphDocStyle& st)
+{
+    if(!st.outline_enable || st.outline_w <= 0) return;
+    p.Begin();
+    if(st.outline_dx || st.outline_dy)
+        p.Translate(st.outline_dx, st.outline_dy);
+    build();
+    const double o = s_clamp01(st.outline_opacity) * s_clamp01(st.opacity);
+    if(o < 1.0) p.Opacity(o);
+    s_dash(p, st.outline_dash);
+    p.Stroke((st.enable_stroke ? st.stroke_w : 0) + max(1, 2 * st.outline_w), st.outline);
+    p.End();
+}
+
+static void s_pass_fill(BufferPainter& p, const Function<void ()>& build, const GlyphDocStyle& st)
+{
+    if(!st.enable_fill) return;
+    p.Begin();
+    build();
+    if(st.even_odd) p.EvenOdd(true);
+    const double o = s_clamp01(st.fill_opacity) * s_clamp01(st.opacity);
+    if(o < 1.0) p.Opacity(o);
+    p.Fill(st.fill);
+    p.End();
+}
+
+static void s_pass_stroke(BufferPainter& p, const Function<void ()>& build, const GlyphDocStyle& st)
+{
+    if(!st.enable_stroke) return;
+    p.Begin();
+    build();
+    const double o = s_clamp01(st.stroke_opacity) * s_clamp01(st.opacity);
+    if(o < 1.0) p.Opacity(o);
+    s_dash(p, st.dash);
+    p.Stroke(st.stroke_w, st.stroke);
+    p.End();
+}
+
+static void s_emit_shape(BufferPainter& p, const Rect& inset, const GlyphDocShape& s)
+{
+    const GlyphDocStyle& st = s.style;
+    auto P = [&](Pointf q) { return Pointf(s_nx(inset, q.x), s_ny(inset, q.y)); };
+
+    Function<void ()> path;
+    bool fill = true;
+    switch(s.type) {
+    case GD_RECT: {
+        Rectf r(s_nx(inset, s.x), s_ny(inset, s.y), s_nx(inset, s.x + s.w), s_ny(inset, s.y + s.h));
+        r.Normalize();
+        const double rx = min(s_nr(inset, s.rx), r.Width() / 2);
+        const double ry = min(s_nr(inset, s.ry), r.Height() / 2);
+        path = [&p, r, rx, ry] {
+            if(rx > 0 || ry > 0)
+                p.RoundedRectangle(r.left, r.top, r.Width(), r.Height(), rx, ry);
+            else
+                p.Move(r.TopLeft()).Line(r.TopRight()).Line(r.BottomRight()).Line(r.BottomLeft()).Close();
+        };
+        break;
+    }
+    case GD_CIRCLE: {
+        const double cx = s_nx(inset, s.cx), cy = s_ny(inset, s.cy), rr = s_nr(inset, s.r);
+        if(rr < 0.5) return;
+        path = [&p, cx, cy, rr] { p.Circle(cx, cy, rr); };
+        break;
+    }
+    case GD_LINE: {
+        const Pointf a = P(s.p1), b = P(s.p2);
+        path = [&p, a, b] { p.Move(a).Line(b); };
+        fill = false;
+        break;
+    }
+    case GD_TRIANGLE: {
+        const Pointf a = P(s.p1), b = P(s.p2), c = P(s.p3);
+        path = [&p, a, b, c] { p.Move(a).Line(b).Line(c).Close(); };
+        break;
+    }
+    case GD_CURVE: {
+        const Pointf a0 = P(s.a0), a1 = P(s.a1), c0 = P(s.c0), c1 = P(s.c1);
+        const bool cubic = s.cubic, closed = s.closed;
+        path = [&p, a0, a1, c0, c1, cubic, closed] {
+            p.Move(a0);
+            if(cubic) p.Cubic(c0, c1, a1);
+            else      p.Quadratic(c0, a1);
+            if(closed) p.Close();
+        };
+        fill = closed;
+        break;
+    }
+    case GD_TEXT: {
+        const int pxh = int(inset.Height() * s.size_n + 0.5);
+        if(s.text.IsEmpty() || pxh < 4) return;
+        Font f = StdFont().Height(pxh);
+        if(!s.face.IsEmpty()) f.FaceName(s.face);
+        if(s.bold)   f.Bold();
+        if(s.italic) f.Italic();
+        const Pointf org(s_nx(inset, s.x), s_ny(inset, s.y));    // TOP-aligned, like the editor
+        const String txt = s.text;
+        path = [&p, org, txt, f] {
+            Pointf pen = org;
+            for(int i = 0; i < txt.GetCount(); ++i) {
+                p.Character(pen, txt[i], f);
+                pen.x += GetTextSize(String(txt[i], 1), f).cx;
+            }
+        };
+        break;
+    }
+    default:
+        return;
+    }
+
+    if(st.outline_enable && st.outline_outside) s_pass_outline(p, path, st);
+    if(fill)                                    s_pass_fill(p, path, st);
+    s_pass_stroke(p, path, st);
+    if(st.outline_enable && !st.outline_outside) s_pass_outline(p, path, st);
+}
+
+// ==== registry ================================================================
+int GalleryCtrl::RegisterGlyph(const String& name, const String& json)
+{
+    GlyphDoc doc;
+    if(!s_load_doc(doc, json))
+        return -1;
+    doc.name = name;
+
+    Array<GlyphDoc>& docs  = s_glyph_docs();
+    Index<String>&   names = s_glyph_names();
+    int q = names.Find(name);
+    if(q < 0) {
+        q = docs.GetCount();
+        names.Add(name);
+        docs.Add(pick(doc));
+    }
+    else {
+        docs[q] = pick(doc);
+        // drop stale rasterizations of the replaced document; badge atlases
+        // built from them are rebuilt by their controls' next paint
+        const int id = GLYPH__COUNT + q;
+        ArrayMap<int, Image>& cache = GlyphCache();
+        for(int i = cache.GetCount() - 1; i >= 0; --i)
+            if((cache.GetKey(i) >> 16) == id)
+                cache.Remove(i);
+        s_glyph_gen()++;
+    }
+    return GLYPH__COUNT + q;
+}
+
+int GalleryCtrl::GlyphGeneration()
+{
+    return s_glyph_gen();
+}
+
+int GalleryCtrl::RegisterGlyphFile(const String& name, const String& path)
+{
+    String json = LoadFile(path);
+    return json.IsVoid() ? -1 : RegisterGlyph(name, json);
+}
+
+int GalleryCtrl::FindGlyph(const String& name)
+{
+    const int q = s_glyph_names().Find(name);
+    return q < 0 ? -1 : GLYPH__COUNT + q;
+}
+
+int GalleryCtrl::GetGlyphCount()
+{
+    return GLYPH__COUNT + s_glyph_docs().GetCount();
+}
+
+Image GalleryCtrl::RenderGlyphDoc(int id, int tile)
+{
+    const int q = id - GLYPH__COUNT;
+    if(q < 0 || q >= s_glyph_docs().GetCount())
+        return Image();
+    const GlyphDoc& doc = s_glyph_docs()[q];
+
+    // Same aspect table as the editor; the inset is centered in the tile
+    static const int asp[][2] = { {1,1}, {4,3}, {3,2}, {16,9}, {21,9}, {9,16}, {2,3}, {3,4} };
+    const int* a = asp[clamp(doc.aspect_ix, 0, 7)];
+    int iw = tile, ih = tile * a[1] / a[0];
+    if(ih > tile) { ih = tile; iw = tile * a[0] / a[1]; }
+    const Rect inset = RectC((tile - iw) / 2, (tile - ih) / 2, iw, ih);
+
+    ImageBuffer ib(tile, tile);
+    BufferPainter p; p.Create(ib, MODE_ANTIALIASED);
+    p.Clear(RGBAZero());
+    if(doc.bg_enabled)
+        p.Rectangle(inset.left, inset.top, inset.Width(), inset.Height()).Fill(doc.bg);
+
+    if(doc.clip) {
+        p.Begin();
+        p.Rectangle(inset.left, inset.top, inset.Width(), inset.Height()).Clip();
+    }
+    for(const GlyphDocShape& s : doc.shapes)
+        s_emit_shape(p, inset, s);
+    if(doc.clip)
+        p.End();
+
+    p.Finish();
+    return ib;
+}
+
+} // namespace Upp
@@ -0,0 +1,121 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== idle scheduler =========================================================
+// Deferred work is split into small slices and run from a zero-delay timer,
+// highest priority task first, until idle_budget_us is spent. Input and paint
+// events get their turn between ticks, so a large backlog (thousands of
+// decoded images, a zoom change that invalidates every glyph) only stretches
+// the time until it is done, never a single frame.
+
+void GalleryCtrl::Schedule(IdleTask t)
+{
+    const dword bit = 1u << t;
+    if(idle_pending & bit)
+        return;
+    const bool armed = idle_pending != 0;
+    idle_pending |= bit;
+    if(!armed)
+        SetTimeCallback(0, [this] { IdleTick(); }, TIMEID_IDLE);
+}
+
+void GalleryCtrl::IdleTick()
+{
+    const int64 t0 = usecs();
+    while(idle_pending && usecs(t0) < idle_budget_us) {
+        int t = 0;
+        while(!(idle_pending & (1u << t))) ++t;
+        if(!IdleSlice((IdleTask)t))
+            idle_pending &= ~(1u << t);
+    }
+    FlushDirty();
+    if(idle_pending)
+        SetTimeCallback(1, [this] { IdleTick(); }, TIMEID_IDLE);
+}
+
+// Runs every pending task to completion without yielding (no time budget).
+void GalleryCtrl::FlushIdle()
+{
+    KillTimeCallback(TIMEID_IDLE);
+    while(idle_pending) {
+        int t = 0;
+        while(!(idle_pending & (1u << t))) ++t;
+        if(!IdleSlice((IdleTask)t))
+            idle_pending &= ~(1u << t);
+    }
+    FlushDirty();
+}
+
+bool GalleryCtrl::IdleSlice(IdleTask t)
+{
+    switch(t) {
+    case TASK_RESULTS:
+        return DrainSlice();
+    case TASK_AVG:
+        return AverageSlice();
+    case TASK_GRAY:
+        return GraySlice();
+    case TASK_REFINE:
+        return RefineSlice();
+    case TASK_GLYPHS:
+        if(glyph_todo.IsEmpty())
+            return false;
+        Glyph(glyph_todo.Top().x, glyph_todo.Top().y);
+        glyph_todo.Drop();
+        return !glyph_todo.IsEmpty();
+    case TASK_TEXT: {
+        if(text_todo.IsEmpty())
+            return false;
+        const int r = text_todo.Pop();
+        const CT::Step& st  = label_layout.step[zoom_i];
+        const int*      fid = label_field[zoom_i];
+        for(int i = r * cols; i < min((r + 1) * cols, items.GetCount()); ++i)
+            for(int b = 0; b < st.count; ++b)
+                if(st.box[b].type == CT::SegmentType::Text && fid[b] != FIELD_NONE && fid[b] != FIELD_FLAGS)
+                    FitText(fid[b], i, items[i], st.box[b]);
+        return !text_todo.IsEmpty();
+    }
+    default:
+        return false;
+    }
+}
+
+// Rows just outside the viewport are measured ahead, so scrolling into them
+// finds their labels in the text cache.
+void GalleryCtrl::QueueTextRows(int first_row, int last_row)
+{
+    if(first_row == text_first_row && last_row == text_last_row)
+        return;
+    text_first_row = first_row;
+    text_last_row  = last_row;
+    text_todo.Clear();
+    for(int r : { first_row - 2, first_row - 1, last_row + 2, last_row + 1 })  // popped from the back
+        if(r >= 0 && r < rows)
+            text_todo.Add(r);
+    if(text_todo.GetCount())
+        Schedule(TASK_TEXT);
+}
+
+void GalleryCtrl::DirtyTile(int index)
+{
+    idle_dirty.Add(index);
+}
+
+void GalleryCtrl::FlushDirty()
+{
+    enum { MAX_TILE_RECTS = 64 };           // past this, one full refresh is cheaper
+    if(idle_dirty.GetCount() > MAX_TILE_RECTS)
+        Refresh();
+    else {
+        const Rect view = GetSize();
+        for(int i : idle_dirty) {
+            const Rect tr = TileRect(i).Offseted(-scroll_x, -scroll_y);
+            if(tr.Intersects(view))
+                Refresh(tr);
+        }
+    }
+    idle_dirty.SetCount(0);
+}
+
+} // namespace Upp
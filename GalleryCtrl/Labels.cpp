@@ -0,0 +1,131 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== label layout ===========================================================
+// Geometry comes from a CT::Table compiled ahead of time (GalleryLayout.h);
+// field names are bound to ids once per layout, so painting is a walk over
+// fixed boxes for the current zoom step.
+
+void GalleryCtrl::SetLabelLayout(const CT::Table& t)
+{
+    label_layout = t;
+    label_preset.Clear();
+    label_template_spec.Clear();
+    SyncLabelLayout();
+    Reflow();
+    PrewarmGlyphs();
+    Refresh();
+}
+
+bool GalleryCtrl::SetLabelPreset(const String& name)
+{
+    if(!AssignLabelPreset(name))
+        return false;
+    SyncLabelLayout();
+    Reflow();
+    PrewarmGlyphs();
+    Refresh();
+    return true;
+}
+
+bool GalleryCtrl::AssignLabelPreset(const String& name)
+{
+    for(const CT::Preset& p : CT::PRESETS)
+        if(name == p.name) {
+            label_layout = *p.table;
+            label_preset = name;
+            label_template_spec.Clear();
+            return true;
+        }
+    return false;
+}
+
+int GalleryCtrl::FieldId(const char* field) const
+{
+    if(!field || !*field)          return FIELD_NONE;
+    if(strcmp(field, "name") == 0)   return FIELD_NAME;
+    if(strcmp(field, "index") == 0)  return FIELD_INDEX;
+    if(strcmp(field, "status") == 0) return FIELD_STATUS;
+    if(strcmp(field, "flags") == 0)  return FIELD_FLAGS;
+    const int q = FindField(field);       // metadata column
+    return q >= 0 ? q : FIELD_NONE;
+}
+
+void GalleryCtrl::SyncLabelLayout()
+{
+    for(int z = 0; z < CT::ZOOM_COUNT; ++z) {
+        const CT::Step& st = label_layout.step[z];
+        for(int b = 0; b < CT::MAX_BOXES; ++b)
+            label_field[z][b] = b < st.count ? FieldId(st.box[b].field) : FIELD_NONE;
+    }
+    const bool on = lod[zoom_i] & LOD_LABELS;
+    band_before = on ? label_layout.step[zoom_i].before_h : 0;
+    band_after  = on ? label_layout.step[zoom_i].after_h  : 0;
+}
+
+int GalleryCtrl::LabelIconGlyph(const GalleryItem& it, int field) const
+{
+    if(field == FIELD_STATUS)
+        switch(it.status) {
+        case ThumbStatus::Ok:          return GLYPH_STATUS_OK;
+        case ThumbStatus::Error:       return GLYPH_STATUS_ERR;
+        case ThumbStatus::Missing:
+        case ThumbStatus::Placeholder: return GLYPH_STATUS_WARN;
+        default:                       return -1;
+        }
+    if(field == FIELD_FLAGS)
+        for(int b = 0; b < 32; ++b)
+            if((it.flags & (1u << b)) && flag_glyph[b] >= 0)
+                return flag_glyph[b];
+    return -1;
+}
+
+void GalleryCtrl::PaintLabels(Draw& w, int index, const GalleryItem& it, const Rect& rt, Color back)
+{
+    const CT::Step& st  = label_layout.step[zoom_i];
+    const int*      fid = label_field[zoom_i];
+
+    if(band_before > 0)
+        w.DrawRect(RectC(rt.left, rt.top, rt.GetWidth(), band_before), back);
+    if(band_after > 0)
+        w.DrawRect(RectC(rt.left, rt.bottom - band_after, rt.GetWidth(), band_after), back);
+
+    const Font fnt = StdFont();
+    for(int b = 0; b < st.count; ++b) {
+        const CT::Box& bx = st.box[b];
+        const Rect r = RectC(rt.left + bx.x, rt.top + bx.y, bx.cx, bx.cy);
+
+        if(bx.type == CT::SegmentType::Icon) {
+            const int g = LabelIconGlyph(it, fid[b]);
+            if(g >= 0) {
+                const int gs = max(8, bx.cy - 4);
+                w.DrawImage(r.left + (r.GetWidth() - gs) / 2, r.top + (r.GetHeight() - gs) / 2, Glyph(g, gs));
+            }
+            continue;
+        }
+
+        if(fid[b] == FIELD_NONE || fid[b] == FIELD_FLAGS)
+            continue;
+        const TextFit& f = FitText(fid[b], index, it, bx);
+        if(f.shown.IsEmpty())
+            continue;
+
+        if(bx.region == CT::Region::Overlay)
+            w.DrawRect(r, back);
+
+        const int ty = r.top + (r.GetHeight() - fnt.GetCy()) / 2;
+        if(f.clip) {
+            w.Clip(r);
+            w.DrawText(r.left, ty, f.shown, fnt, SColorText());
+            w.End();
+            continue;
+        }
+        const int tx = bx.align < 0 ? r.left
+                     : bx.align > 0 ? r.right - f.width
+                     :                r.left + (r.GetWidth() - f.width) / 2;
+        w.DrawText(tx, ty, f.shown, fnt, SColorText());
+    }
+}
+
+} // namespace Upp
@@ -0,0 +1,71 @@
+#ifndef _GalleryCtrl_MpscQueue_h_
+#define _GalleryCtrl_MpscQueue_h_
+
+#include <atomic>
+
+namespace Upp {
+
+//----------------------------------------------------------------------------
+//  Lock-free multi-producer / single-consumer queue (intrusive, Vyukov)
+//
+//  Push() may be called from any thread; Pop() only from the consumer.
+//  A producer preempted between its two stores can make Pop() report empty
+//  for a moment; the element is returned by a later Pop().
+//----------------------------------------------------------------------------
+template <class T>
+class MpscQueue {
+    struct Node {
+        std::atomic<Node*> next { nullptr };
+        T                  value;
+    };
+
+    std::atomic<Node*> head;        // last pushed (producers)
+    Node*              tail;        // next to pop (consumer)
+    Node               stub;
+
+    void Link(Node* n) {
+        n->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head.exchange(n, std::memory_order_acq_rel);
+        prev->next.store(n, std::memory_order_release);
+    }
+
+public:
+    void Push(T&& v) {
+        Node* n = new Node;
+        n->value = pick(v);
+        Link(n);
+    }
+
+    bool Pop(T& out) {
+        Node* t    = tail;
+        Node* next = t->next.load(std::memory_order_acquire);
+        if(t == &stub) {
+            if(!next)
+                return false;
+            tail = t = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if(!next) {
+            if(t != head.load(std::memory_order_acquire))
+                return false;                   // producer between exchange and link
+            Link(&stub);
+            next = t->next.load(std::memory_order_acquire);
+            if(!next)
+                return false;
+        }
+        tail = next;
+        out = pick(t->value);
+        delete t;
+        return true;
+    }
+
+    MpscQueue()  { head.store(&stub); tail = &stub; }
+    ~MpscQueue() { T t; while(Pop(t)); }
+
+    MpscQueue(const MpscQueue&) = delete;
+    void operator=(const MpscQueue&) = delete;
+};
+
+} // namespace Upp
+
+#endif
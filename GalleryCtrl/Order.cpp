@@ -0,0 +1,154 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== item order =============================================================
+// SetOrder() permutes items together with every per-item column in place of
+// re-adding them. Results of decodes submitted before the reorder still arrive
+// with their old index: the generation bump is recorded with an old -> new
+// index map (composed across reorders, last few kept) that DrainSlice applies.
+//
+// Name sorting compares precomputed natural-order keys: case-folded UTF-8 with
+// each digit run replaced by '0', its significant digit count and the digits,
+// so "Item 2" < "Item 10" with a plain memcmp.
+
+String GalleryCtrl::NaturalKey(const String& name)
+{
+    const WString s = ToLower(name.ToWString());
+    StringBuffer out;
+    for(int i = 0; i < s.GetCount();) {
+        if(s[i] < '0' || s[i] > '9') {
+            int j = i;
+            while(j < s.GetCount() && (s[j] < '0' || s[j] > '9'))
+                ++j;
+            out.Cat(ToUtf8(s.Mid(i, j - i)));
+            i = j;
+            continue;
+        }
+        while(i + 1 < s.GetCount() && s[i] == '0' && s[i + 1] >= '0' && s[i + 1] <= '9')
+            ++i;                                 // leading zeros do not count
+        int j = i;
+        while(j < s.GetCount() && s[j] >= '0' && s[j] <= '9')
+            ++j;
+        for(int k = i; k < j; k += 255) {        // longer runs split, still ordered
+            const int len = min(255, j - k);
+            out.Cat('0');
+            out.Cat((char)len);
+            for(int q = 0; q < len; ++q)
+                out.Cat((char)s[k + q]);
+        }
+        i = j;
+    }
+    return String(out);
+}
+
+void GalleryCtrl::SortByName(bool descending)
+{
+    Vector<int> order;
+    order.SetCount(items.GetCount());
+    for(int i = 0; i < order.GetCount(); ++i)
+        order[i] = i;
+    CoSort(order, [&](int a, int b) {
+        const int q = SgnCompare(name_key[a], name_key[b]);
+        if(q)
+            return descending ? q > 0 : q < 0;
+        return a < b;                            // stable among equal keys
+    });
+    SetOrder(order);
+}
+
+template <class V>
+static void s_permute(V& v, const Vector<int>& order)
+{
+    if(v.GetCount() != order.GetCount())
+        return;                                  // column unused by this field type
+    V t;
+    t.SetCount(order.GetCount());
+    for(int k = 0; k < order.GetCount(); ++k)
+        t[k] = pick(v[order[k]]);
+    v = pick(t);
+}
+
+bool GalleryCtrl::SetOrder(const Vector<int>& order)
+{
+    const int n = items.GetCount();
+    if(order.GetCount() != n)
+        return false;
+    Vector<int> pos;                             // old index -> new index
+    pos.SetCount(n, -1);
+    for(int k = 0; k < n; ++k) {
+        const int o = order[k];
+        if(o < 0 || o >= n || pos[o] >= 0)
+            return false;                        // not a permutation
+        pos[o] = k;
+    }
+
+    s_permute(items, order);
+    for(MetaField& f : fields) {
+        s_permute(f.text, order);
+        s_permute(f.num, order);
+        s_permute(f.num2, order);
+        s_permute(f.real, order);
+    }
+    s_permute(avg_color, order);
+    s_permute(preview_hash, order);
+    s_permute(name_key, order);
+    s_permute(phash, order);
+
+    Vector<byte> hist;
+    hist.SetCount(color_hist.GetCount());
+    for(int k = 0; k < n; ++k)
+        memcpy(&hist[k * HIST_BINS], &color_hist[order[k] * HIST_BINS], HIST_BINS);
+    color_hist = pick(hist);
+
+    PackedBits had = pick(phash_bits);
+    phash_bits.SetCount(n);
+    for(int k = 0; k < n; ++k)
+        phash_bits.Set(k, had.Get(order[k]));
+
+    sel_bits.Zero();
+    filt_bits.Zero();
+    flag_bits.Zero();
+    for(PackedBits& b : status_bits)
+        b.Zero();
+    for(PackedBits& b : flag_index)
+        b.Zero();
+    for(int i = 0; i < n; ++i) {                 // counts are unchanged by a permutation
+        const GalleryItem& it = items[i];
+        sel_bits.Set(i, it.selected);
+        filt_bits.Set(i, it.filtered_out);
+        flag_bits.Set(i, it.flags != DF_None);
+        status_bits[(int)it.status].Set(i, true);
+        for(dword f = it.flags; f; f &= f - 1)
+            flag_index[LowestBit64(f)].Set(i, true);
+    }
+    density_cols = -1;                           // buckets rebuilt on next paint
+
+    for(int& i : avg_todo)
+        i = i < n ? pos[i] : i;
+    auto remap = [&](int& i) { if(i >= 0 && i < n) i = pos[i]; };
+    remap(hover_index);
+    remap(anchor_index);
+    remap(caret_index);
+    for(int k = 0; k < layer_ring.GetCount(); ++k)
+        remap(layer_ring[k]);
+
+    // in-flight results: keep a map from each recent generation to today's index
+    enum { KEEP_GENS = 4 };
+    for(Vector<int>& m : gen_remap)
+        for(int& i : m)
+            i = i >= 0 && i < n ? pos[i] : -1;
+    gen_remap.Add(item_gen, pick(pos));
+    while(gen_remap.GetCount() > KEEP_GENS)
+        gen_remap.Remove(0);
+    item_gen++;
+
+    preview_cache.Clear();
+    idle_dirty.Clear();
+    name_index_dirty = true;
+    Refresh();
+    WhenOrder(order);
+    return true;
+}
+
+} // namespace Upp
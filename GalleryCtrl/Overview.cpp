@@ -0,0 +1,181 @@
+#include "GalleryCtrl.h"
+
+#ifdef CPU_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Upp {
+
+// ==== overview ===============================================================
+// Below the smallest zoom step every item is a 2..8 px block of its average
+// thumbnail color. Averages (and the other per-thumbnail features: preview
+// hash, dHash, color histogram) are computed when thumbnails arrive (TASK_AVG,
+// one parallel batch per idle slice, sized so a batch takes at most half the
+// idle budget) and painting fills one ImageBuffer directly, so a full-screen
+// 2 px overview of ~2M cells is a single blit.
+
+// Channel sums over (at most ~1M sampled) pixels; channel order follows RGBA
+// memory layout, so the result is valid premultiplied RGBA again.
+static RGBA s_average(const Image& img)
+{
+    const Size sz = img.GetSize();
+    if(sz.cx <= 0 || sz.cy <= 0)
+        return RGBAZero();
+    const int ystep = 1 + (int)((int64)sz.cx * sz.cy >> 20);
+
+    uint64 sum[4] = { 0, 0, 0, 0 };
+    int64  n = 0;
+    for(int y = 0; y < sz.cy; y += ystep) {
+        const byte* s = (const byte*)img[y];
+        int x = 0;
+#ifdef CPU_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = zero;                  // one 32-bit lane per channel
+        for(; x + 4 <= sz.cx; x += 4) {
+            const __m128i v = _mm_loadu_si128((const __m128i*)(s + 4 * x));
+            const __m128i p = _mm_add_epi16(_mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero));
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(p, zero), _mm_unpackhi_epi16(p, zero)));
+        }
+        alignas(16) uint32 lane[4];
+        _mm_store_si128((__m128i*)lane, acc);
+        for(int k = 0; k < 4; ++k)
+            sum[k] += lane[k];
+#endif
+        for(; x < sz.cx; ++x)
+            for(int k = 0; k < 4; ++k)
+                sum[k] += s[4 * x + k];
+        n += sz.cx;
+    }
+
+    RGBA out;
+    byte* o = (byte*)&out;
+    for(int k = 0; k < 4; ++k)
+        o[k] = (byte)(sum[k] / n);
+    return out;
+}
+
+void GalleryCtrl::ThumbChanged(int index)
+{
+    avg_todo.Add(index);
+    Schedule(TASK_AVG);
+}
+
+bool GalleryCtrl::AverageSlice()
+{
+    enum { MIN_BATCH = 4, MAX_BATCH = 64 };
+    const int n = min(avg_todo.GetCount(), avg_batch);
+    if(n == 0)
+        return false;
+    Vector<int> batch;
+    batch.Append(avg_todo, avg_todo.GetCount() - n, n);
+    avg_todo.Trim(avg_todo.GetCount() - n);
+    Sort(batch);                             // distinct slots for the parallel writes
+    batch.SetCount(int(std::unique(batch.begin(), batch.end()) - batch.begin()));
+
+    const int64 t0 = usecs();
+    CoFor(batch.GetCount(), [&](int k) {
+        const int i = batch[k];
+        if(i < items.GetCount() && !items[i].thumb.IsEmpty()) {
+            avg_color[i]    = s_average(items[i].thumb);
+            preview_hash[i] = EncodePreviewHash(items[i].thumb);    // for the app to persist
+            phash[i]        = PerceptualHash(items[i].thumb);
+            ColorHistogram(items[i].thumb, &color_hist[i * HIST_BINS]);
+        }
+    });
+    const int64 dt = usecs() - t0;           // large thumbnails cost more: adapt
+    if(dt > idle_budget_us / 2)
+        avg_batch = max(avg_batch / 2, (int)MIN_BATCH);
+    else
+    if(n == avg_batch && dt < idle_budget_us / 4)
+        avg_batch = min(avg_batch * 2, (int)MAX_BATCH);
+    for(int i : batch) {                     // bit words are shared: set serially
+        if(i < items.GetCount())
+            phash_bits.Set(i, !items[i].thumb.IsEmpty());
+        preview_cache.RemoveKey(i);
+    }
+    if(overview)
+        Refresh();
+    return !avg_todo.IsEmpty();
+}
+
+void GalleryCtrl::SetOverview(int cell_px)
+{
+    cell_px = cell_px <= 0 ? 0 : clamp(cell_px, 2, 8);
+    if(overview == cell_px) return;
+    const int keep = (scroll_y / max(1, CellH() + Gap())) * cols;   // first visible item
+    overview = cell_px;
+    Reflow();
+    sb.SetY(max(0, TileRect(keep).top - Gap()));
+    scroll_y = sb.GetY();
+    Refresh();
+}
+
+void GalleryCtrl::PaintOverview(Draw& w)
+{
+    const Size sz = GetSize();
+    if(sz.cx <= 0 || sz.cy <= 0)
+        return;
+    ImageBuffer ib(sz);
+
+    const RGBA face = SColorFace();
+    const RGBA sel  = SColorHighlight();
+    const RGBA none = Blend(SColorFace(), SColorShadow(), 48);
+    const RGBA err  = Blend(SColorFace(), LtRed(), 160);
+    const RGBA warn = Blend(SColorFace(), Color(230, 170, 40), 160);
+    Fill(~ib, face, ib.GetLength());
+
+    const int cell  = overview;
+    const int row0  = scroll_y / cell;
+    const int row1  = min(rows - 1, (scroll_y + sz.cy - 1) / cell);
+    const int col0  = scroll_x / cell;
+    const int col1  = min(cols - 1, (scroll_x + sz.cx - 1) / cell);
+    const byte* fb  = (const byte*)&face;
+
+    for(int r = row0; r <= row1; ++r) {
+        const int y0 = max(0, r * cell - scroll_y);
+        const int y1 = min(sz.cy, r * cell - scroll_y + cell);
+        if(y0 >= y1)
+            continue;
+        RGBA* line = ib[y0];
+        for(int c = col0; c <= col1; ++c) {
+            const int i = r * cols + c;
+            if(i >= items.GetCount())
+                break;
+            const GalleryItem& it = items[i];
+
+            RGBA px;
+            if(it.selected)
+                px = sel;
+            else
+            if(it.status != ThumbStatus::Error && it.status != ThumbStatus::Missing && avg_color[i].a) {
+                const RGBA a  = avg_color[i];   // premultiplied, over face; preview DC before decode
+                const byte* ab = (const byte*)&a;
+                byte* pb = (byte*)&px;
+                for(int k = 0; k < 4; ++k)
+                    pb[k] = (byte)(ab[k] + fb[k] * (255 - a.a) / 255);
+                px.a = 255;
+                if(it.filtered_out) {
+                    const byte g = (byte)((px.r * 77 + px.g * 150 + px.b * 29) >> 8);
+                    px.r = (byte)((g + face.r) / 2);
+                    px.g = (byte)((g + face.g) / 2);
+                    px.b = (byte)((g + face.b) / 2);
+                }
+            }
+            else
+                px = it.status == ThumbStatus::Error   ? err
+                   : it.status == ThumbStatus::Missing ? warn
+                   :                                     none;
+
+            const int x0 = max(0, c * cell - scroll_x);
+            const int x1 = min(sz.cx, c * cell - scroll_x + cell);
+            if(x0 < x1)
+                Fill(line + x0, px, x1 - x0);
+        }
+        for(int y = y0 + 1; y < y1; ++y)     // rest of the cell row is a copy
+            memcpy(ib[y], line, sz.cx * sizeof(RGBA));
+    }
+
+    w.DrawImage(0, 0, ib);
+}
+
+} // namespace Upp
@@ -0,0 +1,127 @@
+#ifndef _GalleryCtrl_PackedBits_h_
+#define _GalleryCtrl_PackedBits_h_
+
+#ifdef COMPILER_MSC
+#include <intrin.h>
+#endif
+
+namespace Upp {
+
+inline int Popcount64(uint64 v)
+{
+#ifdef COMPILER_MSC
+    return (int)__popcnt64(v);
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+// index of the lowest set bit; v != 0
+inline int LowestBit64(uint64 v)
+{
+#ifdef COMPILER_MSC
+    unsigned long b;
+    _BitScanForward64(&b, v);
+    return (int)b;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+//----------------------------------------------------------------------------
+//  Packed per-item bit column (one bit per item, 64 per word)
+//
+//  Set() reports whether the bit actually changed, so callers can keep
+//  derived counts up to date; Count() is a popcount over a range of items.
+//  Boolean operators work a word at a time (operands of equal count).
+//----------------------------------------------------------------------------
+class PackedBits : Moveable<PackedBits> {
+    Vector<uint64> w;
+    int            n = 0;
+
+public:
+    PackedBits() {}
+    PackedBits(const PackedBits& b, int) : w(b.w, 1), n(b.n) {}   // deep copy
+    PackedBits(PackedBits&&) = default;
+    PackedBits& operator=(PackedBits&&) = default;
+
+    void Assign(const PackedBits& b) {      // copy, reusing this column's storage
+        n = b.n;
+        w.SetCount(b.w.GetCount());
+        if(w.GetCount())
+            memcpy(w.begin(), b.w.begin(), w.GetCount() * sizeof(uint64));
+    }
+
+    void SetCount(int count) {
+        n = count;
+        w.SetCount((count + 63) >> 6, 0);
+        if(count & 63)                          // shrink: drop bits past the end
+            w.Top() &= ~(uint64)0 >> (64 - (count & 63));
+    }
+    int  GetCount() const                   { return n; }
+    void Clear()                            { w.Clear(); n = 0; }
+    void Zero()                             { Fill(w.begin(), w.end(), (uint64)0); }
+
+    bool Get(int i) const                   { return (w[i >> 6] >> (i & 63)) & 1; }
+    bool Set(int i, bool b) {
+        uint64& x = w[i >> 6];
+        const uint64 m = (uint64)1 << (i & 63);
+        if(!!(x & m) == b)
+            return false;
+        x ^= m;
+        return true;
+    }
+
+    int  Count() const {
+        int c = 0;
+        for(uint64 x : w)
+            c += Popcount64(x);
+        return c;
+    }
+    int  Count(int from, int to) const {      // [from, to)
+        if(from >= to)
+            return 0;
+        const int a = from >> 6, b = (to - 1) >> 6;
+        const uint64 lo = ~(uint64)0 << (from & 63);
+        const uint64 hi = ~(uint64)0 >> (63 - ((to - 1) & 63));
+        if(a == b)
+            return Popcount64(w[a] & lo & hi);
+        int c = Popcount64(w[a] & lo) + Popcount64(w[b] & hi);
+        for(int k = a + 1; k < b; ++k)
+            c += Popcount64(w[k]);
+        return c;
+    }
+
+    // next set bit at or after i, -1 if none
+    int  Next(int i) const {
+        if(i >= n)
+            return -1;
+        int k = i >> 6;
+        uint64 x = w[k] & (~(uint64)0 << (i & 63));
+        while(!x) {
+            if(++k >= w.GetCount())
+                return -1;
+            x = w[k];
+        }
+        return (k << 6) + LowestBit64(x);
+    }
+
+    PackedBits& operator&=(const PackedBits& b) { for(int k = 0; k < w.GetCount(); ++k) w[k] &= b.w[k]; return *this; }
+    PackedBits& operator|=(const PackedBits& b) { for(int k = 0; k < w.GetCount(); ++k) w[k] |= b.w[k]; return *this; }
+    PackedBits& operator^=(const PackedBits& b) { for(int k = 0; k < w.GetCount(); ++k) w[k] ^= b.w[k]; return *this; }
+    PackedBits& AndNot(const PackedBits& b)     { for(int k = 0; k < w.GetCount(); ++k) w[k] &= ~b.w[k]; return *this; }
+    PackedBits& Invert() {
+        for(uint64& x : w)
+            x = ~x;
+        SetCount(n);                            // clear the bits past the end again
+        return *this;
+    }
+
+    const uint64* Words() const             { return w.begin(); }
+    uint64*       Words()                   { return w.begin(); }
+    int           WordCount() const         { return w.GetCount(); }
+};
+
+} // namespace Upp
+
+#endif
@@ -0,0 +1,176 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== view presets ===========================================================
+// A preset is the view side of a tab (zoom, aspect, toggles, label layout),
+// never the items. SetViewState() assigns everything first and then reflows,
+// prewarms and repaints exactly once, so switching tabs does not cascade
+// through the individual setters.
+
+static const char* s_aspect_name[] = { "fit", "fill", "stretch" };
+static const char* s_scroll_name[] = { "auto", "vertical", "horizontal", "none" };
+
+template <class E, int N>
+static E s_enum_of(const Value& v, const char* (&names)[N], E def)
+{
+    const String s = ToLower(AsString(v));
+    for(int i = 0; i < N; ++i)
+        if(s == names[i])
+            return (E)i;
+    return def;
+}
+
+GalleryViewState GalleryCtrl::GetViewState() const
+{
+    GalleryViewState s;
+    s.zoom_i               = zoom_i;
+    s.overview             = overview;
+    s.aspect               = aspect;
+    s.scroll_mode          = scroll_mode;
+    s.pad                  = pad;
+    s.show_sel_ring        = show_sel_ring;
+    s.show_filter_ring     = show_filter_ring;
+    s.hover_enabled        = hover_enabled;
+    s.saturation_on        = saturation_on;
+    s.label_backdrop_alpha = label_backdrop_alpha;
+    s.badge_min_zoom       = badge_min_zoom;
+    s.adaptive_quality     = adaptive_quality;
+    s.density_strip        = density_on;
+    for(int z = 0; z < CT::ZOOM_COUNT; ++z)
+        s.lod[z] = lod[z];
+    s.label_preset         = label_preset;
+    s.label_template       = label_template_spec;
+    return s;
+}
+
+void GalleryCtrl::SetViewState(const GalleryViewState& s)
+{
+    const int  zi           = clamp(s.zoom_i, 0, ZoomStepCount() - 1);
+    const bool zoom_changed = zi != zoom_i;
+
+    zoom_i               = zi;
+    overview             = s.overview <= 0 ? 0 : clamp(s.overview, 2, 8);
+    aspect               = s.aspect;
+    scroll_mode          = s.scroll_mode;
+    pad                  = clamp(s.pad, 0, 64);
+    show_sel_ring        = s.show_sel_ring;
+    show_filter_ring     = s.show_filter_ring;
+    hover_enabled        = s.hover_enabled;
+    saturation_on        = s.saturation_on;
+    label_backdrop_alpha = clamp(s.label_backdrop_alpha, 0, 255);
+    badge_min_zoom       = clamp(s.badge_min_zoom, 0, ZoomStepCount());
+    adaptive_quality     = s.adaptive_quality;
+    fast_scroll          = fast_scroll && adaptive_quality;
+    for(int z = 0; z < CT::ZOOM_COUNT; ++z)
+        lod[z] = s.lod[z];
+    if(!hover_enabled)
+        hover_index = -1;
+    if(s.density_strip != density_on) {
+        density_on = s.density_strip;
+        if(density_on)
+            AddFrame(density.Width(6));
+        else
+            RemoveFrame(density);
+    }
+
+    // label tables are only rebuilt when the preset actually differs
+    if(!s.label_preset.IsEmpty()) {
+        if(s.label_preset != label_preset)
+            AssignLabelPreset(s.label_preset);
+    }
+    else
+    if(!s.label_template.IsEmpty() && (s.label_template != label_template_spec || !label_preset.IsEmpty()))
+        AssignLabelTemplate(s.label_template);
+
+    if(zoom_changed)
+        DropLayers();
+    SyncLabelLayout();
+    Reflow();
+    PrewarmGlyphs();
+    Refresh();
+    if(zoom_changed)
+        WhenZoom(zoom_i);
+}
+
+String GalleryCtrl::SavePreset() const
+{
+    const GalleryViewState s = GetViewState();
+    ValueMap m;
+    m("zoom", s.zoom_i)
+     ("overview", s.overview)
+     ("aspect", s_aspect_name[(int)s.aspect])
+     ("scroll", s_scroll_name[(int)s.scroll_mode])
+     ("padding", s.pad)
+     ("selection_borders", s.show_sel_ring)
+     ("filter_borders", s.show_filter_ring)
+     ("hover", s.hover_enabled)
+     ("saturation", s.saturation_on)
+     ("label_backdrop_alpha", s.label_backdrop_alpha)
+     ("badge_min_zoom", s.badge_min_zoom)
+     ("adaptive_quality", s.adaptive_quality)
+     ("density_strip", s.density_strip);
+    ValueArray lod;
+    for(dword l : s.lod)
+        lod.Add((int)l);
+    m("lod", lod);
+    if(!s.label_preset.IsEmpty())
+        m("label_preset", s.label_preset);
+    else
+    if(!s.label_template.IsEmpty())
+        m("label_template", s.label_template);
+    return AsJSON(m, true);
+}
+
+bool GalleryCtrl::LoadPreset(const String& json)
+{
+    Value v = ParseJSON(json);
+    if(!IsValueMap(v))
+        return false;
+    ValueMap m = v;
+
+    GalleryViewState s = GetViewState();
+    auto get_int  = [&](const char* k, int& d)  { Value x = m[k]; if(IsNumber(x)) d = (int)x; };
+    auto get_bool = [&](const char* k, bool& d) { Value x = m[k]; if(IsNumber(x)) d = (bool)x; };
+
+    get_int("zoom", s.zoom_i);
+    get_int("overview", s.overview);
+    if(m.Find("aspect") >= 0) s.aspect      = s_enum_of(m["aspect"], s_aspect_name, s.aspect);
+    if(m.Find("scroll") >= 0) s.scroll_mode = s_enum_of(m["scroll"], s_scroll_name, s.scroll_mode);
+    get_int("padding", s.pad);
+    get_bool("selection_borders", s.show_sel_ring);
+    get_bool("filter_borders", s.show_filter_ring);
+    get_bool("hover", s.hover_enabled);
+    get_bool("saturation", s.saturation_on);
+    get_int("label_backdrop_alpha", s.label_backdrop_alpha);
+    get_int("badge_min_zoom", s.badge_min_zoom);
+    get_bool("adaptive_quality", s.adaptive_quality);
+    get_bool("density_strip", s.density_strip);
+    if(IsValueArray(m["lod"])) {
+        ValueArray lod = m["lod"];
+        for(int z = 0; z < min(lod.GetCount(), (int)CT::ZOOM_COUNT); ++z)
+            if(IsNumber(lod[z]))
+                s.lod[z] = (dword)(int)lod[z] & LOD_ALL;
+    }
+
+    if(m.Find("label_preset") >= 0) {
+        const String name = m["label_preset"];
+        bool known = false;
+        for(const CT::Preset& p : CT::PRESETS)
+            known = known || name == p.name;
+        if(known) {
+            s.label_preset = name;
+            s.label_template.Clear();
+        }
+    }
+    else
+    if(m.Find("label_template") >= 0) {
+        s.label_preset.Clear();
+        s.label_template = m["label_template"];
+    }
+
+    SetViewState(s);
+    return true;
+}
+
+} // namespace Upp
@@ -0,0 +1,197 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== compact previews =======================================================
+// BlurHash-compatible strings: a handful of DCT components in base83, ~28
+// bytes for the default 4x3. Decoding is a few thousand multiply-adds, so
+// visible tiles decode on first paint; a bounded cache keeps the results.
+
+static const char s_b83[] =
+    "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz#$%*+,-.:;=?@[]^_{|}~";
+
+static void s_enc83(String& out, int v, int digits)
+{
+    for(int i = 1; i <= digits; ++i) {
+        int d = v;
+        for(int k = 0; k < digits - i; ++k) d /= 83;
+        out.Cat(s_b83[d % 83]);
+    }
+}
+
+static int s_dec83(const char* s, int n)
+{
+    int v = 0;
+    for(int i = 0; i < n; ++i) {
+        const char* q = strchr(s_b83, s[i]);
+        if(!q || !s[i]) return -1;
+        v = v * 83 + int(q - s_b83);
+    }
+    return v;
+}
+
+static double s_to_linear(int v)
+{
+    const double x = v / 255.0;
+    return x <= 0.04045 ? x / 12.92 : pow((x + 0.055) / 1.055, 2.4);
+}
+
+static int s_to_srgb(double v)
+{
+    v = clamp(v, 0.0, 1.0);
+    return v <= 0.0031308 ? int(v * 12.92 * 255 + 0.5) : int((1.055 * pow(v, 1 / 2.4) - 0.055) * 255 + 0.5);
+}
+
+static double s_sign_pow(double v, double e)
+{
+    return v < 0 ? -pow(-v, e) : pow(v, e);
+}
+
+String GalleryCtrl::EncodePreviewHash(const Image& src, int cx, int cy)
+{
+    cx = clamp(cx, 1, 9);
+    cy = clamp(cy, 1, 9);
+    if(src.IsEmpty())
+        return String();
+    // components only need a coarse image; keeps encoding O(32 x 32)
+    const Size ssz = src.GetSize();
+    const Image img = max(ssz.cx, ssz.cy) > 32
+                    ? Rescale(src, ssz.cx >= ssz.cy ? Size(32, max(1, 32 * ssz.cy / ssz.cx))
+                                                    : Size(max(1, 32 * ssz.cx / ssz.cy), 32))
+                    : src;
+    const Size sz = img.GetSize();
+
+    Vector<double> f;                     // cx * cy * rgb
+    f.SetCount(cx * cy * 3, 0.0);
+    for(int y = 0; y < sz.cy; ++y) {
+        const RGBA* s = img[y];
+        for(int x = 0; x < sz.cx; ++x) {
+            const double r = s_to_linear(s[x].r), g = s_to_linear(s[x].g), b = s_to_linear(s[x].b);
+            for(int j = 0; j < cy; ++j)
+                for(int i = 0; i < cx; ++i) {
+                    const double basis = cos(M_PI * i * x / sz.cx) * cos(M_PI * j * y / sz.cy);
+                    double* c = &f[(j * cx + i) * 3];
+                    c[0] += basis * r;
+                    c[1] += basis * g;
+                    c[2] += basis * b;
+                }
+        }
+    }
+    for(int k = 0; k < cx * cy; ++k) {
+        const double norm = (k == 0 ? 1.0 : 2.0) / (sz.cx * sz.cy);
+        for(int c = 0; c < 3; ++c)
+            f[k * 3 + c] *= norm;
+    }
+
+    String out;
+    s_enc83(out, (cx - 1) + (cy - 1) * 9, 1);
+    double maxv = 1;
+    if(cx * cy > 1) {
+        double actual = 0;
+        for(int k = 3; k < f.GetCount(); ++k)
+            actual = max(actual, fabs(f[k]));
+        const int q = clamp(int(floor(actual * 166 - 0.5)), 0, 82);
+        maxv = (q + 1) / 166.0;
+        s_enc83(out, q, 1);
+    }
+    else
+        s_enc83(out, 0, 1);
+    s_enc83(out, (s_to_srgb(f[0]) << 16) + (s_to_srgb(f[1]) << 8) + s_to_srgb(f[2]), 4);
+    for(int k = 1; k < cx * cy; ++k) {
+        int v = 0;
+        for(int c = 0; c < 3; ++c)
+            v = v * 19 + clamp(int(floor(s_sign_pow(f[k * 3 + c] / maxv, 0.5) * 9 + 9.5)), 0, 18);
+        s_enc83(out, v, 2);
+    }
+    return out;
+}
+
+Image GalleryCtrl::DecodePreviewHash(const String& hash, Size sz)
+{
+    if(hash.GetCount() < 6 || sz.cx <= 0 || sz.cy <= 0)
+        return Image();
+    const int flag = s_dec83(~hash, 1);
+    const int nx = flag % 9 + 1, ny = flag / 9 + 1;
+    if(flag < 0 || hash.GetCount() != 4 + 2 * nx * ny)
+        return Image();
+    const double maxv = (s_dec83(~hash + 1, 1) + 1) / 166.0;
+
+    Vector<double> c;
+    c.SetCount(nx * ny * 3);
+    const int dc = s_dec83(~hash + 2, 4);
+    if(dc < 0)
+        return Image();
+    c[0] = s_to_linear(dc >> 16);
+    c[1] = s_to_linear((dc >> 8) & 255);
+    c[2] = s_to_linear(dc & 255);
+    for(int k = 1; k < nx * ny; ++k) {
+        const int v = s_dec83(~hash + 4 + 2 * k, 2);
+        if(v < 0)
+            return Image();
+        c[k * 3 + 0] = s_sign_pow((v / (19 * 19) - 9) / 9.0, 2) * maxv;
+        c[k * 3 + 1] = s_sign_pow((v / 19 % 19 - 9) / 9.0, 2) * maxv;
+        c[k * 3 + 2] = s_sign_pow((v % 19 - 9) / 9.0, 2) * maxv;
+    }
+
+    // separable basis tables
+    Buffer<double> bx(sz.cx * nx), by(sz.cy * ny);
+    for(int x = 0; x < sz.cx; ++x)
+        for(int i = 0; i < nx; ++i)
+            bx[x * nx + i] = cos(M_PI * x * i / sz.cx);
+    for(int y = 0; y < sz.cy; ++y)
+        for(int j = 0; j < ny; ++j)
+            by[y * ny + j] = cos(M_PI * y * j / sz.cy);
+
+    ImageBuffer ib(sz);
+    for(int y = 0; y < sz.cy; ++y) {
+        RGBA* t = ib[y];
+        for(int x = 0; x < sz.cx; ++x) {
+            double r = 0, g = 0, b = 0;
+            for(int j = 0; j < ny; ++j)
+                for(int i = 0; i < nx; ++i) {
+                    const double basis = bx[x * nx + i] * by[y * ny + j];
+                    const double* k = &c[(j * nx + i) * 3];
+                    r += k[0] * basis;
+                    g += k[1] * basis;
+                    b += k[2] * basis;
+                }
+            t[x].r = (byte)s_to_srgb(r);
+            t[x].g = (byte)s_to_srgb(g);
+            t[x].b = (byte)s_to_srgb(b);
+            t[x].a = 255;
+        }
+    }
+    return ib;
+}
+
+void GalleryCtrl::SetPreviewHash(int index, const String& hash)
+{
+    if(!TryItem(index)) return;
+    preview_hash[index] = hash;
+    preview_cache.RemoveKey(index);
+    // DC term is the average color: the overview has something to show at once
+    if(avg_color[index].a == 0 && hash.GetCount() >= 6) {
+        const int dc = s_dec83(~hash + 2, 4);
+        if(dc >= 0)
+            avg_color[index] = Color(dc >> 16, (dc >> 8) & 255, dc & 255);
+    }
+    Refresh();
+}
+
+String GalleryCtrl::GetPreviewHash(int index) const
+{
+    return TryItem(index) ? preview_hash[index] : String();
+}
+
+const Image& GalleryCtrl::PreviewImage(int index)
+{
+    enum { CACHE_MAX = 2048, EDGE = 32 };
+    int q = preview_cache.Find(index);
+    if(q >= 0)
+        return preview_cache[q];
+    if(preview_cache.GetCount() >= CACHE_MAX)
+        preview_cache.Clear();
+    return preview_cache.Add(index, DecodePreviewHash(preview_hash[index], Size(EDGE, EDGE)));
+}
+
+} // namespace Upp
@@ -0,0 +1,50 @@
+#ifndef _GalleryCtrl_ScratchArena_h_
+#define _GalleryCtrl_ScratchArena_h_
+
+namespace Upp {
+
+//----------------------------------------------------------------------------
+//  Reusable temporaries for one event or frame
+//
+//  Slots are handed out in stack order within a Scope and given back when it
+//  ends. Each keeps its capacity, so once the largest event has been seen the
+//  following ones never touch the heap. Scopes nest: a handler that paints
+//  synchronously gets slots above the ones its caller still holds.
+//----------------------------------------------------------------------------
+class ScratchArena : NoCopy {
+    Array<Vector<int>> ints;        // Array: slot addresses survive growth
+    Array<PackedBits>  bits;
+    int                ints_used = 0;
+    int                bits_used = 0;
+
+public:
+    class Scope : NoCopy {
+        ScratchArena& a;
+        int           ints_mark, bits_mark;
+
+    public:
+        Scope(ScratchArena& a) : a(a), ints_mark(a.ints_used), bits_mark(a.bits_used) {}
+        ~Scope()                        { a.ints_used = ints_mark; a.bits_used = bits_mark; }
+    };
+
+    Vector<int>& Ints() {                       // empty
+        if(ints_used == ints.GetCount())
+            ints.Add();
+        Vector<int>& v = ints[ints_used++];
+        v.SetCount(0);
+        return v;
+    }
+
+    PackedBits& Bits(int count) {               // 'count' bits, all clear
+        if(bits_used == bits.GetCount())
+            bits.Add();
+        PackedBits& b = bits[bits_used++];
+        b.SetCount(count);
+        b.Zero();
+        return b;
+    }
+};
+
+} // namespace Upp
+
+#endif
@@ -0,0 +1,91 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== similarity order =======================================================
+// Every item with features becomes a point in 5 dimensions: Y, Cb, Cr of its
+// average color and two structure measures of its dHash (edge count, top vs
+// bottom balance). Sorting by the point's position along a Hilbert curve keeps
+// neighbours in feature space mostly adjacent in the grid: O(n log n), no
+// pairwise distances. Structure dims get a quarter of the range so color
+// dominates; equal curve positions fall back to hash order.
+
+enum { SIM_DIMS = 5, SIM_BITS = 12 };
+
+// Skilling, "Programming the Hilbert curve" (2004): axes -> transposed index
+static void s_axes_to_hilbert(uint32 (&x)[SIM_DIMS])
+{
+    const uint32 m = 1u << (SIM_BITS - 1);
+    for(uint32 q = m; q > 1; q >>= 1) {
+        const uint32 p = q - 1;
+        for(int i = 0; i < SIM_DIMS; ++i)
+            if(x[i] & q)
+                x[0] ^= p;
+            else {
+                const uint32 t = (x[0] ^ x[i]) & p;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+    }
+    for(int i = 1; i < SIM_DIMS; ++i)
+        x[i] ^= x[i - 1];
+    uint32 t = 0;
+    for(uint32 q = m; q > 1; q >>= 1)
+        if(x[SIM_DIMS - 1] & q)
+            t ^= q - 1;
+    for(int i = 0; i < SIM_DIMS; ++i)
+        x[i] ^= t;
+}
+
+static uint64 s_hilbert_key(uint32 (&x)[SIM_DIMS])
+{
+    s_axes_to_hilbert(x);
+    uint64 key = 0;                              // interleave, top bit plane first
+    for(int b = SIM_BITS - 1; b >= 0; --b)
+        for(int i = 0; i < SIM_DIMS; ++i)
+            key = (key << 1) | ((x[i] >> b) & 1);
+    return key;
+}
+
+void GalleryCtrl::SortBySimilarity()
+{
+    const int n = items.GetCount();
+    const uint32 full = (1u << SIM_BITS) - 1;
+
+    Vector<uint64> key;
+    key.SetCount(n);
+    CoFor(n, [&](int i) {
+        const RGBA a = avg_color[i];
+        if(a.a == 0 || !phash_bits.Get(i)) {
+            key[i] = ~(uint64)0;                 // no features yet: keep at the end
+            return;
+        }
+        const int r = a.r * 255 / a.a, g = a.g * 255 / a.a, b = a.b * 255 / a.a;
+        const uint64 h = phash[i];
+        const int edges   = Popcount64(h);                                   // 0..64
+        const int balance = Popcount64(h >> 32) - Popcount64(h & 0xffffffff); // -32..32
+        uint32 x[SIM_DIMS] = {
+            (uint32)((r * 77 + g * 150 + b * 29) >> 8) * full / 255,                 // Y
+            (uint32)clamp(128 + ((-43 * r - 85 * g + 128 * b) >> 8), 0, 255) * full / 255, // Cb
+            (uint32)clamp(128 + ((128 * r - 107 * g - 21 * b) >> 8), 0, 255) * full / 255, // Cr
+            (uint32)edges * (full / 4) / 64,
+            (uint32)(balance + 32) * (full / 4) / 64,
+        };
+        key[i] = s_hilbert_key(x);               // 60 bits, below the sentinel
+    });
+
+    Vector<int> order;
+    order.SetCount(n);
+    for(int i = 0; i < n; ++i)
+        order[i] = i;
+    CoSort(order, [&](int a, int b) {
+        if(key[a] != key[b])
+            return key[a] < key[b];
+        if(phash[a] != phash[b])
+            return phash[a] < phash[b];
+        return a < b;
+    });
+    SetOrder(order);
+}
+
+} // namespace Upp
@@ -0,0 +1,190 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== shared thumbnail cache =================================================
+// Image is itself reference counted, so a cache hit costs one Image copy and
+// the pixels exist once no matter how many tabs show the asset. The refcount
+// kept here only decides what may be evicted: entries still shown by some
+// item are pinned, the rest are dropped oldest-first when over budget.
+
+namespace {
+
+struct ThumbEntry {
+    Image  img;
+    int    refs  = 0;
+    int64  bytes = 0;
+    int64  tick  = 0;              // last use, for LRU eviction
+};
+
+struct ThumbStore {
+    Mutex                        lock;
+    ArrayMap<String, ThumbEntry> map;
+    int64                        budget = (int64)256 << 20;
+    int64                        usage  = 0;
+    int64                        tick   = 0;
+    int64                        hits   = 0;
+    int64                        misses = 0;
+
+    // Evicts unreferenced entries, least recently used first, until the
+    // store fits the budget (or only pinned entries remain). refs == 0 does
+    // not mean no Image is alive (SetThumbImage releases before it replaces,
+    // Acquire callers keep copies), so evicted pixels are dropped, not
+    // recycled into the tile pool.
+    void Trim(int64 limit) {
+        if(usage <= limit)
+            return;
+        Vector<int> idle;
+        for(int i = 0; i < map.GetCount(); ++i)
+            if(map[i].refs == 0)
+                idle.Add(i);
+        Sort(idle, [&](int a, int b) { return map[a].tick < map[b].tick; });
+        Vector<int> drop;
+        for(int i : idle) {
+            if(usage <= limit)
+                break;
+            usage -= map[i].bytes;
+            drop.Add(i);
+        }
+        Sort(drop);
+        map.Remove(drop);
+    }
+};
+
+ThumbStore& s_store()
+{
+    static ThumbStore s;
+    return s;
+}
+
+}
+
+String ThumbCache::FileKey(const String& path)
+{
+    const String p = NormalizePath(path);
+    FindFile ff(p);
+    if(!ff)
+        return p;
+    return p + "|" + AsString(ff.GetLength()) + "|" + AsString(Time(ff.GetLastWriteTime()).Get());
+}
+
+Image ThumbCache::Acquire(const String& key)
+{
+    ThumbStore& s = s_store();
+    Mutex::Lock __(s.lock);
+    const int q = s.map.Find(key);
+    if(q < 0) {
+        s.misses++;
+        return Image();
+    }
+    ThumbEntry& e = s.map[q];
+    e.refs++;
+    e.tick = ++s.tick;
+    s.hits++;
+    return e.img;
+}
+
+Image ThumbCache::Insert(const String& key, const Image& img)
+{
+    ThumbStore& s = s_store();
+    Mutex::Lock __(s.lock);
+    int q = s.map.Find(key);
+    if(q >= 0) {                           // first decode wins; later ones share it
+        ThumbEntry& e = s.map[q];
+        e.refs++;
+        e.tick = ++s.tick;
+        return e.img;
+    }
+    ThumbEntry& e = s.map.Add(key);
+    e.img   = img;
+    e.refs  = 1;
+    e.bytes = (int64)img.GetLength() * sizeof(RGBA);
+    e.tick  = ++s.tick;
+    s.usage += e.bytes;
+    s.Trim(s.budget);
+    return img;
+}
+
+void ThumbCache::Release(const String& key)
+{
+    if(key.IsEmpty())
+        return;
+    ThumbStore& s = s_store();
+    Mutex::Lock __(s.lock);
+    const int q = s.map.Find(key);
+    if(q < 0 || s.map[q].refs <= 0)
+        return;
+    if(--s.map[q].refs == 0)
+        s.Trim(s.budget);
+}
+
+void ThumbCache::Purge()
+{
+    ThumbStore& s = s_store();
+    Mutex::Lock __(s.lock);
+    s.Trim(0);
+}
+
+void ThumbCache::SetBudget(int64 bytes)
+{
+    ThumbStore& s = s_store();
+    Mutex::Lock __(s.lock);
+    s.budget = max(bytes, (int64)0);
+    s.Trim(s.budget);
+}
+
+int64 ThumbCache::GetBudget()  { ThumbStore& s = s_store(); Mutex::Lock __(s.lock); return s.budget; }
+int64 ThumbCache::GetUsage()   { ThumbStore& s = s_store(); Mutex::Lock __(s.lock); return s.usage; }
+int   ThumbCache::GetCount()   { ThumbStore& s = s_store(); Mutex::Lock __(s.lock); return s.map.GetCount(); }
+int64 ThumbCache::GetHits()    { ThumbStore& s = s_store(); Mutex::Lock __(s.lock); return s.hits; }
+int64 ThumbCache::GetMisses()  { ThumbStore& s = s_store(); Mutex::Lock __(s.lock); return s.misses; }
+
+// ==== GalleryCtrl side =======================================================
+
+void GalleryCtrl::ReleaseThumb(GalleryItem& it)
+{
+    if(it.thumb_key.IsEmpty())
+        return;
+    ThumbCache::Release(it.thumb_key);
+    it.thumb_key.Clear();
+}
+
+void GalleryCtrl::AssignThumb(GalleryItem& it, const Image& img, const String& key)
+{
+    if(!key.IsEmpty() && it.thumb_key == key)
+        return;
+    Image shared = key.IsEmpty() ? img : ThumbCache::Insert(key, img);
+    ReleaseThumb(it);
+    DropLayers(it);
+    it.thumb      = shared;
+    it.thumb_key  = key;
+    ThumbChanged(int(&it - items.begin()));
+}
+
+bool GalleryCtrl::SetThumbShared(int index, const String& key)
+{
+    GalleryItem* it = TryItem(index);
+    if(!it) return false;
+    if(it->thumb_key == key && !key.IsEmpty())
+        return true;
+    Image img = ThumbCache::Acquire(key);
+    if(img.IsEmpty())
+        return false;
+    ReleaseThumb(*it);
+    DropLayers(*it);
+    it->thumb      = img;
+    it->thumb_key  = key;
+    ThumbChanged(index);
+    Refresh();
+    return true;
+}
+
+void GalleryCtrl::SetThumbShared(int index, const String& key, const Image& img)
+{
+    GalleryItem* it = TryItem(index);
+    if(!it) return;
+    AssignThumb(*it, img, key);
+    Refresh();
+}
+
+} // namespace Upp
@@ -0,0 +1,202 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== tile pool ==============================================================
+// An Image owns its pixels, but an ImageBuffer built from the only reference to
+// an Image takes them over without a copy, and Image(ImageBuffer&) hands them
+// back. Free lists therefore hold plain Images and Take() turns one into a
+// writable buffer again. A block still referenced elsewhere when it is taken
+// is copied rather than shared: a stray reference costs an allocation (and
+// counts as a miss, not a reuse), never correctness.
+
+namespace {
+
+enum { MAX_CLASSES = 128 };
+
+struct SizeClass {
+    Vector<Image> free;
+    int64         tick = 0;                // last take / recycle, for LRU trimming
+};
+
+struct TileStore {
+    Mutex                     lock;
+    ArrayMap<Size, SizeClass> map;
+    int64                     budget = (int64)32 << 20;
+    int64                     tick   = 0;
+    TilePoolStats             st;
+
+    // Frees waiting buffers, least recently used size class first, until the
+    // free lists fit 'limit'.
+    void Trim(int64 limit) {
+        while(st.bytes > limit) {
+            int lru = -1;
+            for(int i = 0; i < map.GetCount(); ++i)
+                if(map[i].free.GetCount() && (lru < 0 || map[i].tick < map[lru].tick))
+                    lru = i;
+            if(lru < 0)
+                break;
+            Vector<Image>& f = map[lru].free;
+            st.bytes -= (int64)f.Top().GetLength() * sizeof(RGBA);
+            st.dropped++;
+            f.Drop();
+            if(f.IsEmpty())
+                st.classes--;
+        }
+    }
+
+    // Forgets sizes with nothing waiting (odd aspect ratios seen once).
+    void Compact() {
+        Vector<int> empty;
+        for(int i = 0; i < map.GetCount(); ++i)
+            if(map[i].free.IsEmpty())
+                empty.Add(i);
+        map.Remove(empty);
+    }
+};
+
+TileStore& s_tiles()
+{
+    static TileStore s;
+    return s;
+}
+
+}
+
+void TilePool::Take(ImageBuffer& ib, Size sz)
+{
+    Image m;
+    {
+        TileStore& s = s_tiles();
+        Mutex::Lock __(s.lock);
+        s.st.takes++;
+        const int q = s.map.Find(sz);
+        if(q >= 0 && s.map[q].free.GetCount()) {
+            SizeClass& c = s.map[q];
+            m = c.free.Pop();
+            c.tick = ++s.tick;
+            s.st.bytes -= (int64)m.GetLength() * sizeof(RGBA);
+            if(c.free.IsEmpty())
+                s.st.classes--;
+        }
+    }
+    if(m.IsEmpty()) {
+        ib.Create(sz);
+        return;
+    }
+    const RGBA* block = ~m;
+    ib = m;                                    // sole owner: pixels move, no copy
+    ib.SetKind(IMAGE_UNKNOWN);                 // the caller overwrites every pixel
+    if(~ib == block) {                         // moved; a shared block was copied: a miss
+        TileStore& s = s_tiles();
+        Mutex::Lock __(s.lock);
+        s.st.reused++;
+    }
+}
+
+void TilePool::Recycle(Image& img)
+{
+    if(img.IsEmpty())
+        return;
+    TileStore& s = s_tiles();
+    Mutex::Lock __(s.lock);
+    s.st.recycled++;
+    if(s.budget <= 0) {
+        s.st.dropped++;
+        img = Image();
+        return;
+    }
+    const Size sz = img.GetSize();
+    int q = s.map.Find(sz);
+    if(q < 0) {
+        if(s.map.GetCount() >= MAX_CLASSES)
+            s.Compact();
+        q = s.map.GetCount();
+        s.map.Add(sz);
+    }
+    SizeClass& c = s.map[q];
+    if(c.free.IsEmpty())
+        s.st.classes++;
+    c.free.Add(img);
+    c.tick = ++s.tick;
+    img = Image();
+    s.st.bytes += (int64)sz.cx * sz.cy * sizeof(RGBA);
+    s.st.peak   = max(s.st.peak, s.st.bytes);
+    s.Trim(s.budget);
+}
+
+void TilePool::Purge()
+{
+    TileStore& s = s_tiles();
+    Mutex::Lock __(s.lock);
+    s.Trim(0);
+    s.Compact();
+}
+
+void TilePool::SetBudget(int64 bytes)
+{
+    TileStore& s = s_tiles();
+    Mutex::Lock __(s.lock);
+    s.budget = max(bytes, (int64)0);
+    s.Trim(s.budget);
+}
+
+int64 TilePool::GetBudget()          { TileStore& s = s_tiles(); Mutex::Lock __(s.lock); return s.budget; }
+TilePoolStats TilePool::GetStats()   { TileStore& s = s_tiles(); Mutex::Lock __(s.lock); return s.st; }
+
+void TilePool::ResetStats()
+{
+    TileStore& s = s_tiles();
+    Mutex::Lock __(s.lock);
+    s.st.takes = s.st.reused = s.st.recycled = s.st.dropped = 0;
+    s.st.peak  = s.st.bytes;
+}
+
+// ==== GalleryCtrl side =======================================================
+// Gray and mip copies are kept for recently shown items only. Once more items
+// hold layers than the limit (by default three screens' worth), the oldest
+// ones outside the visible rows and a screen of margin give their pixels back
+// to the pool, where the tiles scrolling in pick them up.
+
+void GalleryCtrl::NoteLayer(int index)
+{
+    layer_ring.AddTail(index);
+    TrimLayers();
+}
+
+void GalleryCtrl::TrimLayers()
+{
+    if(layer_limit < 0 || cols <= 0)
+        return;
+    const int span  = max(1, paint_last_row - paint_first_row + 1);
+    const int limit = layer_limit ? layer_limit : max(256, 3 * span * cols);
+    const int lo    = (paint_first_row - span) * cols;
+    const int hi    = (paint_last_row + span + 1) * cols;
+    for(int k = layer_ring.GetCount(); k > 0 && layer_ring.GetCount() > limit; --k) {
+        const int i = layer_ring.Head();
+        layer_ring.DropHead();
+        if(i >= lo && i < hi)
+            layer_ring.AddTail(i);             // still (nearly) on screen
+        else
+        if(i < items.GetCount())
+            DropLayers(items[i]);
+    }
+}
+
+void GalleryCtrl::DropLayers(GalleryItem& it)
+{
+    TilePool::Recycle(it.thumb_gray);
+    if(it.thumb_mip.GetSerialId() == it.thumb.GetSerialId())
+        it.thumb_mip = Image();                // the thumbnail itself, not a copy
+    else
+        TilePool::Recycle(it.thumb_mip);
+}
+
+void GalleryCtrl::DropLayers()
+{
+    for(GalleryItem& it : items)
+        DropLayers(it);
+    layer_ring.Clear();
+}
+
+} // namespace Upp
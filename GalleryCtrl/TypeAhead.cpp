@@ -0,0 +1,134 @@
+#include "GalleryCtrl.h"
+
+namespace Upp {
+
+// ==== type-ahead =============================================================
+// Typed characters (with focus) build a prefix that is looked up in a sorted,
+// lower-cased name index: two binary searches give the range of matches, so a
+// query costs O(log n) regardless of gallery size. Typing the same character
+// again cycles through the matches in name order. The index is rebuilt lazily
+// after items are added or reordered.
+
+void GalleryCtrl::SetTypeAhead(bool b)
+{
+    type_ahead = b;
+    WantFocus(b);
+    typed.Clear();
+}
+
+void GalleryCtrl::SyncNameIndex()
+{
+    if(!name_index_dirty)
+        return;
+    const int n = items.GetCount();
+    Vector<String> key;
+    key.SetCount(n);
+    name_order.SetCount(n);
+    for(int i = 0; i < n; ++i) {
+        key[i] = ToLower(items[i].name);
+        name_order[i] = i;
+    }
+    Sort(name_order, [&](int a, int b) { int q = SgnCompare(key[a], key[b]); return q ? q < 0 : a < b; });
+    name_sorted.SetCount(n);
+    name_rank.SetCount(n);
+    for(int k = 0; k < n; ++k) {
+        name_sorted[k] = pick(key[name_order[k]]);
+        name_rank[name_order[k]] = k;
+    }
+    name_index_dirty = false;
+}
+
+// [lo, hi) positions in name_order whose key starts with prefix (lower-case)
+void GalleryCtrl::NamePrefixRange(const String& prefix, int& lo, int& hi)
+{
+    SyncNameIndex();
+    const String* b = name_sorted.begin();
+    const String* e = name_sorted.end();
+    const String* l = std::lower_bound(b, e, prefix);
+    const String* h = std::upper_bound(l, e, prefix, [](const String& p, const String& s) {
+        return SgnCompare(p, s.Left(p.GetCount())) < 0;
+    });
+    lo = int(l - b);
+    hi = int(h - b);
+}
+
+int GalleryCtrl::FindNamePrefix(const String& prefix, int after)
+{
+    int lo, hi;
+    NamePrefixRange(ToLower(prefix), lo, hi);
+    if(lo >= hi)
+        return -1;
+    if(after >= 0 && after < items.GetCount()) {
+        const int k = name_rank[after] + 1;
+        if(k > lo && k < hi)                 // after is a match: take the next one
+            return name_order[k];
+    }
+    return name_order[lo];
+}
+
+void GalleryCtrl::ScrollToItem(int index)
+{
+    if(!TryItem(index))
+        return;
+    const Rect r = TileRect(index);
+    const int  h = GetSize().cy;
+    int y = scroll_y;
+    if(r.top < y)
+        y = r.top - Gap();
+    else
+    if(r.bottom > y + h)
+        y = r.bottom + Gap() - h;
+    if(y == scroll_y)
+        return;
+    sb.SetY(max(0, y));
+    scroll_y = sb.GetY();
+    Refresh();
+}
+
+bool GalleryCtrl::TypeAheadKey(dword key)
+{
+    if(!type_ahead || items.IsEmpty())
+        return false;
+    const int64 now = msecs();
+    if(now - typed_ms > 1000)
+        typed.Clear();
+    if(key == K_ESCAPE && !typed.IsEmpty()) {
+        typed.Clear();
+        return true;
+    }
+    if(key == K_BACKSPACE && !typed.IsEmpty()) {
+        typed.Trim(typed.GetCount() - 1);
+        typed_ms = now;
+        return true;
+    }
+    if(key < ' ' || key >= K_CHAR_LIM)
+        return false;
+
+    const WString c = WString((wchar)key, 1);
+    const bool repeat = typed.GetCount() == 1 && typed[0] == (wchar)key;
+    if(!repeat)
+        typed.Cat(c);
+    typed_ms = now;
+
+    // keep the caret while it still matches, unless cycling with one repeated key
+    const int cur = caret_index >= 0 && caret_index < items.GetCount() ? caret_index : -1;
+    int i;
+    if(repeat)
+        i = FindNamePrefix(typed.ToString(), cur);
+    else
+    if(cur >= 0 && ToLower(items[cur].name).StartsWith(ToLower(typed.ToString())))
+        i = cur;
+    else
+        i = FindNamePrefix(typed.ToString());
+    if(i < 0)
+        return true;                        // consumed, nothing matches
+
+    caret_index = anchor_index = i;
+    Vector<int> sel;
+    sel.Add(i);
+    CommitSelection(sel);
+    ScrollToItem(i);
+    return true;
+}
+
+} // namespace Upp
@@ -0,0 +1,445 @@
+/*
+================================================================================
+ GalleryBench — timing and allocation counts for GalleryCtrl hot paths
+================================================================================
+ Each section builds its inputs first and measures only the calls under test:
+ wall time and the number of heap allocations (malloc / calloc / realloc).
+
+ Allocation counting needs the system allocator: the package's main config is
+ USEMALLOC, and on glibc the allocator entry points are interposed below. On
+ other platforms (or with U++'s own heap) the counts print as "n/a".
+
+ Sections (all by default, or name one on the command line)
+   • add    — Add(const&) vs Add(String&&, ImageBuffer&&) vs AddBatch()
+   • scroll — a long scroll session with and without the tile pool; each
+              variant runs in a child process so peak RSS is its own
+   • marquee — allocations per mouse move of a rubber-band drag; exits with
+              code 1 if a warm drag allocates at all
+   • paint  — frame time of a 4K view of mixed tile states, per aspect policy
+   • decode — files to thumbnails: in-process threads vs the DecodePool
+================================================================================
+*/
+
+#include <CtrlLib/CtrlLib.h>
+#include <GalleryCtrl/GalleryCtrl.h>
+#include <plugin/png/png.h>
+
+using namespace Upp;
+
+// ==== allocation counter =====================================================
+#if defined(flagUSEMALLOC) && defined(PLATFORM_POSIX) && defined(__GLIBC__)
+static std::atomic<int64> s_allocs;
+
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+
+void* malloc(size_t sz)           { s_allocs.fetch_add(1, std::memory_order_relaxed); return __libc_malloc(sz); }
+void* calloc(size_t n, size_t sz) { s_allocs.fetch_add(1, std::memory_order_relaxed); return __libc_calloc(n, sz); }
+void* realloc(void* p, size_t sz) { s_allocs.fetch_add(1, std::memory_order_relaxed); return __libc_realloc(p, sz); }
+}
+
+static int64 Allocs() { return s_allocs.load(std::memory_order_relaxed); }
+#else
+static int64 Allocs() { return -1; }
+#endif
+
+// ==== measurement ============================================================
+struct Probe {
+    int64 allocs;
+    int64 t0;
+
+    Probe()      { Start(); }
+    void Start() { allocs = Allocs(); t0 = usecs(); }
+    int64 Count() const { return allocs < 0 ? -1 : Allocs() - allocs; }   // allocations so far
+
+    void Report(const char* what, int n) const {
+        const double ms = (usecs() - t0) / 1000.0;
+        const int64  a  = Allocs();
+        Cout() << Format("  %-36s %9.2f ms", what, ms);
+        if(allocs < 0)
+            Cout() << "        n/a allocs\n";
+        else
+            Cout() << Format(" %10d allocs (%.2f each)\n", a - allocs, n ? double(a - allocs) / n : 0.0);
+    }
+};
+
+// Resident set (current, peak) in kB from /proc; -1 where unavailable
+static void ReadRss(int64& cur, int64& peak)
+{
+    cur = peak = -1;
+#ifdef PLATFORM_LINUX
+    for(const String& l : Split(LoadFile("/proc/self/status"), '\n')) {
+        if(l.StartsWith("VmRSS:"))
+            cur = ScanInt64(TrimLeft(l.Mid(6)));
+        if(l.StartsWith("VmHWM:"))
+            peak = ScanInt64(TrimLeft(l.Mid(6)));
+    }
+#endif
+}
+
+static Array<GalleryCtrl> s_galleries;          // kept alive: teardown is not measured
+
+static GalleryCtrl& NewGallery()
+{
+    GalleryCtrl& g = s_galleries.Add();
+    g.SetRect(0, 0, 1280, 800);
+    return g;
+}
+
+// ==== add ====================================================================
+static void BenchAdd()
+{
+    enum { N = 20000, EDGE = 64, TEMPLATES = 256 };
+    Cout() << Format("add: %d items, %d px thumbnails\n", (int)N, (int)EDGE);
+
+    Vector<Image> tpl;
+    for(int k = 0; k < TEMPLATES; ++k)
+        tpl.Add(GalleryCtrl::GenRandomThumb(EDGE, 0, 0, 1234u + k * 23u));
+    auto name = [](int i) { return Format("/shows/bench/seq010/shot_%05d_v003.exr", i); };
+
+    // 1) caller keeps its strings and images (const& overload)
+    {
+        Vector<String> names;
+        Vector<Image>  imgs;
+        for(int i = 0; i < N; ++i) {
+            names.Add(name(i));
+            imgs.Add(tpl[i % TEMPLATES]);
+        }
+        GalleryCtrl& g = NewGallery();
+        Probe p;
+        for(int i = 0; i < N; ++i)
+            g.Add(names[i], imgs[i]);
+        p.Report("Add(const String&, const Image&)", N);
+    }
+
+    // 2) caller hands over freshly decoded pixels
+    {
+        Vector<String>     names;
+        Array<ImageBuffer> bufs;
+        for(int i = 0; i < N; ++i) {
+            names.Add(name(i));
+            const Image& t = tpl[i % TEMPLATES];
+            ImageBuffer& b = bufs.Add(new ImageBuffer(t.GetSize()));
+            memcpy(~b, ~t, t.GetLength() * sizeof(RGBA));
+        }
+        GalleryCtrl& g = NewGallery();
+        Probe p;
+        for(int i = 0; i < N; ++i)
+            g.Add(pick(names[i]), pick(bufs[i]));
+        p.Report("Add(String&&, ImageBuffer&&)", N);
+    }
+
+    // 3) one prepared batch
+    {
+        Vector<GalleryNewItem> batch;
+        batch.SetCount(N);
+        for(int i = 0; i < N; ++i) {
+            const Image& t = tpl[i % TEMPLATES];
+            ImageBuffer b(t.GetSize());
+            memcpy(~b, ~t, t.GetLength() * sizeof(RGBA));
+            batch[i].name  = name(i);
+            batch[i].thumb = Image(b);
+        }
+        GalleryCtrl& g = NewGallery();
+        Probe p;
+        g.AddBatch(pick(batch));
+        p.Report("AddBatch(Vector<GalleryNewItem>&&)", N);
+    }
+}
+
+// ==== scroll =================================================================
+// Eight thousand 160 px thumbnails, every fifth one filtered (gray layer), at
+// the 96 px zoom step with adaptive quality on, so every tile that scrolls in
+// gets a prescaled mip. The view scrolls a row per frame to the end and back;
+// each frame is painted and its idle work (mips, grays) run to completion.
+static void ScrollSession(bool pooled)
+{
+    enum { N = 8000, EDGE = 160, TEMPLATES = 64 };
+    if(!pooled)
+        TilePool::SetBudget(0);
+
+    GalleryCtrl& g = NewGallery();
+    g.SetRect(0, 0, 1920, 1080);
+    g.SetAdaptiveQuality(true);
+    g.SetFastScrollSpeed(INT_MAX);           // frames come faster than any real scroll
+    g.SetZoomIndex(3);
+    if(!pooled)
+        g.SetLayerLimit(-1);                 // keep every layer, as before pooling
+
+    Vector<GalleryNewItem> batch;
+    batch.SetCount(N);
+    for(int i = 0; i < N; ++i) {
+        batch[i].name   = Format("shot_%05d", i);
+        batch[i].thumb  = GalleryCtrl::GenRandomThumb(EDGE, 4, 3, 77u + (i % TEMPLATES) * 31u);
+        batch[i].status = ThumbStatus::Ok;
+    }
+    g.AddBatch(pick(batch));
+    PackedBits keep;
+    keep.SetCount(N);
+    for(int i = 0; i < N; ++i)
+        keep.Set(i, i % 5 != 0);
+    g.FilterBits(keep);
+    g.FlushIdle();
+
+    ImageDraw w(g.GetSize());
+    Ctrl& c = g;
+    auto frame = [&](int zdelta) {
+        for(int k = 0; k < 3; ++k)           // three wheel steps = one row
+            c.MouseWheel(Point(0, 0), zdelta, 0);
+        c.Paint(w);
+        g.FlushIdle();
+    };
+
+    int64 rss0, peak0;
+    ReadRss(rss0, peak0);
+    TilePool::ResetStats();
+    int frames = 0;
+    Probe p;
+    for(int dir : { -120, +120 })
+        for(int k = 0; k < N / 16; ++k, ++frames)
+            frame(dir);
+    p.Report(pooled ? "scroll, pooled layers" : "scroll, unpooled layers", frames);
+
+    int64 rss1, peak1;
+    ReadRss(rss1, peak1);
+    const TilePoolStats st = TilePool::GetStats();
+    Cout() << Format("    %d frames, peak RSS %s kB (+%s kB over the loaded gallery)\n", frames,
+                     peak1 < 0 ? String("n/a") : AsString(peak1),
+                     peak1 < 0 ? String("n/a") : AsString(peak1 - rss0));
+    Cout() << Format("    pool: %d takes, %d reused, %d recycled, %d dropped, peak %d kB free in %d sizes\n",
+                     st.takes, st.reused, st.recycled, st.dropped, st.peak >> 10, st.classes);
+}
+
+static void BenchScroll()
+{
+    Cout() << "scroll: 8000 items, 1920x1080, 96 px tiles, down and back up\n";
+    for(const char* variant : { "plain", "pooled" }) {
+        String out;
+        if(Sys(GetExeFilePath() + " scroll-" + variant, out) == 0)
+            Cout() << out;
+        else
+            Cout() << "  (child process failed)\n";
+    }
+}
+
+// ==== marquee ================================================================
+// A rubber-band drag over 20000 items with a selection gate installed: the
+// band grows over most of a 1920x1080 view and shrinks back. The first sweep
+// sizes the scratch slots and swatches; the next ones are measured, for the
+// mouse events alone and with every frame painted.
+static void BenchMarquee()
+{
+    enum { N = 20000, MOVES = 400, TEMPLATES = 64 };
+    Cout() << Format("marquee: %d items, %d moves per sweep\n", (int)N, 2 * MOVES + 1);
+
+    GalleryCtrl& g = NewGallery();
+    g.SetRect(0, 0, 1920, 1080);
+    Vector<Image> tpl;
+    for(int k = 0; k < TEMPLATES; ++k)
+        tpl.Add(GalleryCtrl::GenRandomThumb(96, 0, 0, 99u + k * 13u));
+    Vector<GalleryNewItem> batch;
+    batch.SetCount(N);
+    for(int i = 0; i < N; ++i) {
+        batch[i].name   = Format("shot_%05d", i);
+        batch[i].thumb  = tpl[i % TEMPLATES];
+        batch[i].status = ThumbStatus::Ok;
+    }
+    g.AddBatch(pick(batch));
+    g.FlushIdle();
+
+    int gate_calls = 0;
+    g.WhenSelecting = [&](const Vector<int>&) { gate_calls++; return true; };
+
+    Ctrl& c = g;
+    ImageDraw w(g.GetSize());
+    const Point from(40, 40);
+    auto sweep = [&](bool paint) {
+        for(int k = 0; k <= 2 * MOVES; ++k) {
+            const int t = k <= MOVES ? k : 2 * MOVES - k;      // out, then back
+            c.MouseMove(from + Point(4 * t, 2 * t), 0);
+            if(paint)
+                c.Paint(w);
+        }
+    };
+
+    c.LeftDown(from, 0);
+    sweep(true);                                 // warm-up
+    {
+        Probe p;
+        sweep(false);
+        const int64 allocs = p.Count();
+        p.Report("drag, mouse events", 2 * MOVES + 1);
+        if(allocs > 0) {
+            Cout() << Format("    FAIL: %d allocations in a warm drag (expected 0)\n", allocs);
+            SetExitCode(1);
+        }
+    }
+    {
+        Probe p;
+        sweep(true);
+        p.Report("drag, mouse events + paint", 2 * MOVES + 1);
+    }
+    c.LeftUp(from, 0);
+    Cout() << Format("    %d gate calls, %d selected at release\n", gate_calls, g.GetSelectionBits().Count());
+}
+
+// ==== paint ==================================================================
+// A 3840x2160 view at the 128 px step with every kind of tile interleaved:
+// settled thumbnails with and without a prescaled mip, filtered ones (gray
+// layer and gray pending), previews, glyph statuses and plain placeholders,
+// every seventh selected. Layers are built once up front so the frames time
+// painting only; idle work queued by a frame is left pending.
+static void BenchPaint()
+{
+    enum { N = 6000, FRAMES = 60, TEMPLATES = 64 };
+    Cout() << Format("paint: %d items, 3840x2160, %d frames per aspect policy\n", (int)N, (int)FRAMES);
+
+    Vector<Image> tpl;
+    for(int k = 0; k < TEMPLATES; ++k)
+        tpl.Add(GalleryCtrl::GenRandomThumb(160, 4, 3, 5u + k * 19u));
+    const String hash = GalleryCtrl::EncodePreviewHash(tpl[0]);
+
+    const struct { AspectPolicy p; const char* what; } policy[] = {
+        { AspectPolicy::Fit,     "frame, fit" },
+        { AspectPolicy::Fill,    "frame, fill" },
+        { AspectPolicy::Stretch, "frame, stretch" },
+    };
+    for(const auto& q : policy) {
+        GalleryCtrl& g = NewGallery();
+        g.SetRect(0, 0, 3840, 2160);
+        g.SetAspectPolicy(q.p);
+        g.SetAdaptiveQuality(true);
+        g.SetZoomIndex(4);
+
+        Vector<GalleryNewItem> batch;
+        batch.SetCount(N);
+        for(int i = 0; i < N; ++i) {
+            GalleryNewItem& m = batch[i];
+            m.name = Format("shot_%05d", i);
+            switch(i % 6) {
+            case 0: case 1: case 2:
+                m.thumb  = tpl[i % TEMPLATES];
+                m.status = ThumbStatus::Ok;
+                break;
+            case 3:  m.status = ThumbStatus::Placeholder; break;
+            case 4:  m.status = ThumbStatus::Error; break;
+            default: m.status = ThumbStatus::Auto; break;      // no glyph: flat tint
+            }
+        }
+        g.AddBatch(pick(batch));
+        PackedBits filt, sel;
+        filt.SetCount(N);
+        sel.SetCount(N);
+        for(int i = 0; i < N; ++i) {
+            filt.Set(i, i % 6 == 1);
+            sel.Set(i, i % 7 == 0);
+            if(i % 6 == 3)
+                g.SetPreviewHash(i, hash);
+        }
+        g.SetFiltered(filt, true);
+        g.SelectBits(sel);
+        g.FlushIdle();                           // mips and grays for the first screen
+        for(int i = 12; i < N; i += 24) {        // a few without layers again:
+            g.SetThumbImage(i, tpl[i % TEMPLATES]);         // no mip
+            g.SetThumbImage(i + 1, tpl[i % TEMPLATES]);     // gray pending
+        }
+
+        Ctrl& c = g;
+        ImageDraw w(g.GetSize());
+        c.Paint(w);                              // warm-up: swatches, glyphs, previews
+        Probe p;
+        for(int k = 0; k < FRAMES; ++k)
+            c.Paint(w);
+        const double ms = (usecs() - p.t0) / 1000.0 / FRAMES;
+        p.Report(q.what, FRAMES);
+        Cout() << Format("    %.3f ms per frame\n", ms);
+    }
+}
+
+// ==== decode =================================================================
+// Four hundred 1024 px PNGs in a temporary folder, decoded and shrunk to the
+// pool's 256 px edge: first by CoFor threads in this process, then by the
+// DecodePool (one worker per core) feeding a gallery, until every item is Ok.
+// The pool's time includes moving the results through the completion queue.
+static void BenchDecode()
+{
+    enum { N = 400, EDGE = 1024, MAX_EDGE = 256 };
+    Cout() << Format("decode: %d PNG files, %d px, to %d px thumbnails, %d cores\n",
+                     (int)N, (int)EDGE, (int)MAX_EDGE, CPU_Cores());
+
+    const String dir = AppendFileName(GetTempDirectory(), Format("gallerybench-%d", (int)usecs()));
+    RealizeDirectory(dir);
+    Vector<String> files;
+    for(int i = 0; i < N; ++i) {
+        files.Add(AppendFileName(dir, Format("img_%04d.png", i)));
+        PNGEncoder().SaveFile(files.Top(), GalleryCtrl::GenRandomThumb(EDGE, 0, 0, 3u + i * 7u));
+    }
+
+    {
+        Vector<Image> out;
+        out.SetCount(N);
+        Probe p;
+        CoFor(N, [&](int i) {
+            Image m = StreamRaster::LoadFileAny(files[i]);
+            const Size sz = m.GetSize();
+            if(max(sz.cx, sz.cy) > MAX_EDGE)
+                m = Rescale(m, sz.cx >= sz.cy ? Size(MAX_EDGE, sz.cy * MAX_EDGE / sz.cx)
+                                              : Size(sz.cx * MAX_EDGE / sz.cy, MAX_EDGE));
+            out[i] = m;
+        });
+        p.Report("in-process threads (CoFor)", N);
+    }
+
+    {
+        DecodePool::Start(0, 5000, MAX_EDGE);
+        GalleryCtrl& g = NewGallery();
+        Vector<GalleryNewItem> batch;
+        batch.SetCount(N);
+        for(int i = 0; i < N; ++i)
+            batch[i].name = GetFileName(files[i]);
+        g.AddBatch(pick(batch));
+        const int64 done0 = DecodePool::GetDecoded() + DecodePool::GetFailed();
+        Probe p;
+        for(int i = 0; i < N; ++i)
+            g.SetThumbFromFile(i, files[i]);
+        while(DecodePool::GetDecoded() + DecodePool::GetFailed() - done0 < N
+              && DecodePool::GetWorkers() > 0) {
+            Ctrl::ProcessEvents();               // posted drain callbacks
+            g.FlushIdle();
+            Sleep(1);
+        }
+        Ctrl::ProcessEvents();
+        g.FlushIdle();
+        p.Report("DecodePool (out of process)", N);
+        Cout() << Format("    %d decoded, %d failed, %d restarts, %d workers\n",
+                         DecodePool::GetDecoded(), DecodePool::GetFailed(),
+                         DecodePool::GetRestarts(), DecodePool::GetWorkers());
+        DecodePool::Stop();
+    }
+
+    DeleteFolderDeep(dir);
+}
+
+GUI_APP_MAIN
+{
+    if(DecodePool::WorkerMain())                 // helper process of the decode section
+        return;
+    const Vector<String>& cmd = CommandLine();
+    const String what = cmd.GetCount() ? cmd[0] : String();
+    if(what == "scroll-plain" || what == "scroll-pooled") {
+        ScrollSession(what == "scroll-pooled");
+        return;
+    }
+    if(what.IsEmpty() || what == "add")
+        BenchAdd();
+    if(what.IsEmpty() || what == "scroll")
+        BenchScroll();
+    if(what.IsEmpty() || what == "marquee")
+        BenchMarquee();
+    if(what.IsEmpty() || what == "paint")
+        BenchPaint();
+    if(what.IsEmpty() || what == "decode")
+        BenchDecode();
+}
@@ -30,6 +30,12 @@ struct DemoWin : TopWindow {
     // Zoom slider limits (match GalleryCtrl ctor: steps = {32,48,64,96,128})
     int zoom_min = 0, zoom_max = 4;
 
+    // Metadata field columns
+    int f_frames = -1, f_version = -1;
+
+    // Remembered view preset (JSON, see GalleryCtrl::SavePreset)
+    String saved_view;
+
     DemoWin() {
         Title("GalleryCtrl — Rich Demo").Sizeable().Zoomable();
 
@@ -87,6 +93,9 @@ struct DemoWin : TopWindow {
         gal.SetHoverEnabled(true);
         gal.SetSaturationOn(true);
         gal.SetLabelBackdropAlpha(160);
+        gal.SetTypeAhead(true);
+        f_frames  = gal.AddField("frames",  FieldType::Range);
+        f_version = gal.AddField("version", FieldType::Int);
 
         // ----- events
         aspect.WhenAction = [&]{
@@ -118,28 +127,69 @@ struct DemoWin : TopWindow {
             b.Add("Aspect: Stretch", [&]{ aspect.SetIndex(2); aspect.WhenAction(); })
              .Radio(gal.GetAspectPolicy() == AspectPolicy::Stretch);
             b.Separator();
+            b.Add("Sort by name",              [&]{ gal.SortByName(); });
+            b.Add("Sort by name (descending)", [&]{ gal.SortByName(true); });
+            b.Add("Sort by visual similarity", [&]{ gal.SortBySimilarity(); });
+            b.Separator();
+            b.Add("Show red shots",   [&]{ gal.SetColorFilter(LtRed()); });
+            b.Add("Show green shots", [&]{ gal.SetColorFilter(LtGreen()); });
+            b.Add("Show blue shots",  [&]{ gal.SetColorFilter(LtBlue()); });
+            b.Add("Show colors like selection", [&]{
+                Vector<int> sel = gal.GetSelection();
+                if(sel.GetCount()) gal.SetColorFilterLike(sel[0]);
+            });
+            b.Add("Clear color filter", [&]{ ApplyNameFilter(~filter); });   // name filter stays
+            b.Separator();
+            b.Add("Select errors without missing tags", [&]{
+                PackedBits q(gal.GetStatusBits(ThumbStatus::Error), 1);
+                gal.SelectBits(q.AndNot(gal.GetFlagBits(DF_TagMissing)));
+                UpdateStatus();
+            });
+            b.Add("Show only missing metadata", [&]{ gal.FilterBits(gal.GetFlagBits(DF_MetaMissing)); });
+            b.Add("Select duplicates of selection", [&]{ gal.SelectDuplicatesOfSelection(); UpdateStatus(); });
+            b.Separator();
+            for(const CT::Preset& p : CT::PRESETS) {
+                const String name = p.name;
+                b.Add("Layout: " + name, [this, name]{ gal.SetLabelPreset(name); UpdateStatus(); })
+                 .Radio(gal.GetLabelPreset() == name);
+            }
+            b.Add("Layout: name + metadata", [&]{ gal.SetLabelTemplate("name; frames, version; status"); })
+             .Radio(gal.GetLabelPreset().IsEmpty());
+            b.Separator();
+            b.Add("Adaptive quality while scrolling", [&]{ gal.SetAdaptiveQuality(!gal.GetAdaptiveQuality()); })
+             .Check(gal.GetAdaptiveQuality());
+            b.Add("Density strip", [&]{ gal.SetDensityStrip(!gal.GetDensityStrip()); })
+             .Check(gal.GetDensityStrip());
+            b.Add("Decode in helper processes", [&]{
+                if(DecodePool::IsRunning()) DecodePool::Stop();
+                else                        DecodePool::Start();
+            }).Check(DecodePool::IsRunning());
+            b.Separator();
+            b.Add("Remember view", [&]{ saved_view = gal.SavePreset(); });
+            b.Add("Restore view", [&]{
+                gal.LoadPreset(saved_view);
+                aspect.SetIndex((int)gal.GetAspectPolicy());
+                chk_hover <<= gal.GetHoverEnabled();
+                chk_color <<= gal.GetSaturationOn();
+                UpdateStatus();
+            }).Enable(!saved_view.IsEmpty());
+            b.Add("Copy view preset JSON", [&]{ WriteClipboardText(gal.SavePreset()); });
+            b.Separator();
             b.Add("Copy constexpr preset sketch", [&]{
                 String code =
-                    "static constexpr CT::Layout<1,1,0> PRESET_HORZ_BADGE_WATERMARK {\n"
+                    "static constexpr CT::Layout<1,1,0> LAYOUT_HORZ_BADGE_WATERMARK {\n"
                     "    CT::Orientation::Horizontal,\n"
-                    "    { CT::Region::Before, std::array{\n"
-                    "        CT::Line{ CT::LineType::Content, CT::ContentLine{\n"
-                    "            CT::LineDiv::D2,\n"
-                    "            { CT::SegmentType::Icon,   \"status\",    0,0,false,0 },\n"
-                    "            { CT::SegmentType::Spacer, nullptr,       0,0,false,0 },\n"
-                    "            { CT::SegmentType::Text,   \"name\",      0,0,true, 0 },\n"
-                    "            48, 0 }, 48, 0 }\n"
-                    "    } },\n"
-                    "    { CT::Region::Overlay, std::array{\n"
-                    "        CT::Line{ CT::LineType::Content, CT::ContentLine{\n"
-                    "            CT::LineDiv::D3,\n"
-                    "            { CT::SegmentType::Spacer, nullptr,       0,0,false,0 },\n"
-                    "            { CT::SegmentType::Text,   \"watermark\", 0,0,true, 0 },\n"
-                    "            { CT::SegmentType::Spacer, nullptr,       0,0,false,0 },\n"
-                    "            96, 0 }, 96, 0 }\n"
-                    "    } },\n"
-                    "    { CT::Region::After, {} }\n"
-                    "};\n";
+                    "    { CT::Line{ CT::LineType::Content, CT::LineDiv::D3,\n"
+                    "        { CT::Segment{ CT::SegmentType::Icon, \"status\", 0,0,false, 0 },\n"
+                    "          CT::SEG_SPACER,\n"
+                    "          CT::Segment{ CT::SegmentType::Text, \"name\",   0,4,true, -1 } }, 0 } },\n"
+                    "    { CT::Line{ CT::LineType::Content, CT::LineDiv::D3,\n"
+                    "        { CT::SEG_SPACER,\n"
+                    "          CT::Segment{ CT::SegmentType::Text, \"index\",  0,2,true, 0 },\n"
+                    "          CT::SEG_SPACER }, 96 } },\n"
+                    "    {}\n"
+                    "};\n"
+                    "static constexpr CT::Table PRESET_HORZ_BADGE_WATERMARK = CT::Compile(LAYOUT_HORZ_BADGE_WATERMARK);\n";
                 WriteClipboardText(code);
                 PromptOK("Copied constexpr sketch to clipboard.");
             });
@@ -155,31 +205,34 @@ struct DemoWin : TopWindow {
 
     void AddRandom(int n) {
         const int start = gal.GetCount();
+        const int choice = gen_pick.GetIndex();
+        Vector<GalleryNewItem> batch;
+        batch.SetCount(n);
         for(int k = 0; k < n; ++k) {
             const int i = start + k;
-            const int idx = gal.Add(Format("Item %d", i + 1));
+            GalleryNewItem& it = batch[k];
+            it.name = Format("Item %d", i + 1);
 
             // occasional statuses for variety
-            if(i % 37 == 0)      gal.SetThumbStatus(idx, ThumbStatus::Placeholder);
-            else if(i % 53 == 0) gal.SetThumbStatus(idx, ThumbStatus::Missing);
-            else if(i % 97 == 0) gal.SetThumbStatus(idx, ThumbStatus::Error);
-            else                 gal.SetThumbStatus(idx, ThumbStatus::Ok);
-
-            if((i % 7) == 0) gal.SetDataFlags(idx, DF_MetaMissing);
-
-            const int choice = gen_pick.GetIndex();
-            if(choice == 0) {
-                Image im = gal.GenRandomThumb(144, 0, 0, 1234u + idx * 23u);
-                gal.SetThumbImage(idx, im);
-            } else if(choice == 1) {
-                gal.SetThumbStatus(idx, ThumbStatus::Error);
-            } else if(choice == 2) {
-                gal.SetThumbStatus(idx, ThumbStatus::Auto);
-            } else if(choice == 3) {
-                gal.SetThumbStatus(idx, ThumbStatus::Missing);
-            } else if(choice == 4) {
-                gal.SetThumbStatus(idx, ThumbStatus::Placeholder);
-            }
+            it.status = i % 37 == 0 ? ThumbStatus::Placeholder
+                      : i % 53 == 0 ? ThumbStatus::Missing
+                      : i % 97 == 0 ? ThumbStatus::Error
+                      :               ThumbStatus::Ok;
+            if((i % 7) == 0) it.flags = DF_MetaMissing;
+
+            if(choice == 0)
+                it.thumb = gal.GenRandomThumb(144, 0, 0, 1234u + i * 23u);
+            else
+                it.status = choice == 1 ? ThumbStatus::Error
+                          : choice == 2 ? ThumbStatus::Auto
+                          : choice == 3 ? ThumbStatus::Missing
+                          : choice == 4 ? ThumbStatus::Placeholder
+                          :               it.status;
+        }
+        gal.AddBatch(pick(batch));      // one reflow for the lot
+        for(int i = start; i < start + n; ++i) {
+            gal.SetFieldRange(i, f_frames, 1001 + 10 * i, 1100 + 10 * i);
+            gal.SetField(i, f_version, (int64)(1 + i % 12));
         }
         ApplyNameFilter(~filter);
         gal.Refresh();
@@ -188,12 +241,11 @@ struct DemoWin : TopWindow {
     void ApplyNameFilter(const String& q) {
         const String needle = ToLower(q);
         const int n = gal.GetCount();
-        for(int i = 0; i < n; ++i) {
-            const String nm = ToLower(Format("Item %d", i + 1));
-            const bool match = needle.IsEmpty() || nm.Find(needle) >= 0;
-            gal.SetFiltered(i, !match); // gray non-matching (demo behavior)
-        }
-        gal.Refresh();
+        PackedBits keep;
+        keep.SetCount(n);
+        for(int i = 0; i < n; ++i)
+            keep.Set(i, needle.IsEmpty() || ToLower(gal.GetName(i)).Find(needle) >= 0);
+        gal.FilterBits(keep);           // gray non-matching (demo behavior)
     }
 
     void UpdateStatus() {
@@ -203,13 +255,16 @@ struct DemoWin : TopWindow {
             gal.GetAspectPolicy() == AspectPolicy::Fit     ? "Fit" :
             gal.GetAspectPolicy() == AspectPolicy::Fill    ? "Fill" :
                                                              "Stretch";
-        status.SetText(Format("Items: %d    Selected: %d    Zoom step: %d    Aspect: %s",
-                              n, sel, gal.GetZoomIndex(), aname));
+        status.SetText(Format("Items: %d    Selected: %d    Zoom step: %d    Aspect: %s    Errors: %d    Meta missing: %d",
+                              n, sel, gal.GetZoomIndex(), aname,
+                              gal.GetStatusCount(ThumbStatus::Error), gal.GetFlagCount(DF_MetaMissing)));
     }
 };
 
 GUI_APP_MAIN
 {
+    if(DecodePool::WorkerMain())      // helper process for out-of-process decoding
+        return;
     SetLanguage(GetSystemLNG());
     DemoWin().Run();
 }